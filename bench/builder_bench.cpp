@@ -0,0 +1,50 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Benchmarks of the request builders of the client.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "elasticsearch/elasticsearch.h"
+
+// Build the body of a bulk request, the argument is the number of index operations.
+static void BM_BulkBuilderStr(benchmark::State& state) {
+    Json::Object document;
+    document.addMemberByKey("name", "Product with a \"quoted\" name");
+    document.addMemberByKey("price", 19.99);
+    document.addMemberByKey("quantity", 12);
+    document.addMemberByKey("available", true);
+
+    BulkBuilder builder;
+    for(int64_t i = 0; i < state.range(0); ++i)
+        builder.index("products", "product", std::to_string(i), document);
+
+    size_t size = 0;
+    for(auto _ : state) {
+        std::string body = builder.str();
+        size = body.size();
+        benchmark::DoNotOptimize(body);
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BulkBuilderStr)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,71 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Benchmarks of the HTTP response parsing on canned byte streams.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "http/response.h"
+#include "payloads.h"
+
+/// Bytes returned by one read on a loopback or LAN connection.
+static const size_t segment = 16384;
+
+// Feed the raw response to a reader in segments, as read on the socket.
+static void parse(benchmark::State& state, const std::string& raw, size_t bodySize) {
+    for(auto _ : state) {
+        std::string output;
+        ResponseReader reader(output, false);
+
+        Result result = MORE_DATA;
+        for(size_t offset = 0; offset < raw.size() && result == MORE_DATA; offset += segment)
+            result = reader.feed(raw.data() + offset, std::min(segment, raw.size() - offset));
+
+        if(result != OK || output.size() != bodySize)
+            state.SkipWithError("Response not parsed.");
+
+        benchmark::DoNotOptimize(output);
+    }
+
+    state.SetBytesProcessed(state.iterations() * raw.size());
+}
+
+// Response with a content-length body, the argument is the number of hits.
+static void BM_ResponseContentLength(benchmark::State& state) {
+    const std::string body = searchResponse(state.range(0));
+    parse(state, httpContentLength(body), body.size());
+}
+BENCHMARK(BM_ResponseContentLength)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// Chunked response with chunks of 8KB, as sent by Elasticsearch.
+static void BM_ResponseChunked(benchmark::State& state) {
+    const std::string body = searchResponse(state.range(0));
+    parse(state, httpChunked(body, 8192), body.size());
+}
+BENCHMARK(BM_ResponseChunked)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// Gzip response inflated while read.
+static void BM_ResponseGzip(benchmark::State& state) {
+    const std::string body = searchResponse(state.range(0));
+    parse(state, httpGzip(body), body.size());
+}
+BENCHMARK(BM_ResponseGzip)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,133 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Benchmarks of the Json parser and serializer on Elasticsearch payloads.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "json/json.h"
+#include "payloads.h"
+
+// Parse a search response, the argument is the number of hits.
+static void BM_ParseSearchResponse(benchmark::State& state) {
+    const std::string payload = searchResponse(state.range(0));
+
+    for(auto _ : state) {
+        Json::Object object;
+        object.addMember(payload.c_str(), payload.c_str() + payload.size());
+        benchmark::DoNotOptimize(object);
+    }
+
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_ParseSearchResponse)->Arg(10)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+// Parse a bulk response, the argument is the number of items.
+static void BM_ParseBulkResponse(benchmark::State& state) {
+    const std::string payload = bulkResponse(state.range(0));
+
+    for(auto _ : state) {
+        Json::Object object;
+        object.addMember(payload.c_str(), payload.c_str() + payload.size());
+        benchmark::DoNotOptimize(object);
+    }
+
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_ParseBulkResponse)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// Parse a mapping, the argument is the number of fields.
+static void BM_ParseMapping(benchmark::State& state) {
+    const std::string payload = mappingResponse(state.range(0));
+
+    for(auto _ : state) {
+        Json::Object object;
+        object.addMember(payload.c_str(), payload.c_str() + payload.size());
+        benchmark::DoNotOptimize(object);
+    }
+
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_ParseMapping)->Arg(50)->Arg(500)->Unit(benchmark::kMicrosecond);
+
+// Serialize a parsed search response, the argument is the number of hits.
+static void BM_SerializeSearchResponse(benchmark::State& state) {
+    const std::string payload = searchResponse(state.range(0));
+
+    Json::Object object;
+    object.addMember(payload.c_str(), payload.c_str() + payload.size());
+
+    size_t size = 0;
+    for(auto _ : state) {
+        std::string output = object.str();
+        size = output.size();
+        benchmark::DoNotOptimize(output);
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_SerializeSearchResponse)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// Escape a string without special characters.
+static void BM_EscapePlainString(benchmark::State& state) {
+    const std::string input(state.range(0), 'a');
+
+    for(auto _ : state)
+        benchmark::DoNotOptimize(Json::Value::escapeJsonString(input));
+
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_EscapePlainString)->Arg(16)->Arg(1024);
+
+// Escape a string where one character in eight must be escaped.
+static void BM_EscapeSpecialString(benchmark::State& state) {
+    std::string input;
+    while(input.size() < static_cast<size_t>(state.range(0)))
+        input += "abc\"de\\f\n";
+
+    for(auto _ : state)
+        benchmark::DoNotOptimize(Json::Value::escapeJsonString(input));
+
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_EscapeSpecialString)->Arg(16)->Arg(1024);
+
+// Read the numbers of a parsed hit, the values are converted at each access.
+static void BM_NumericGetters(benchmark::State& state) {
+    const std::string payload = searchResponse(1);
+
+    Json::Object object;
+    object.addMember(payload.c_str(), payload.c_str() + payload.size());
+    const Json::Object& hits = object.getValue("hits").getObject();
+    const Json::Object& source = hits.getValue("hits").getArray().first().getObject().getValue("_source").getObject();
+
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(hits.getValue("total").getLong());
+        benchmark::DoNotOptimize(hits.getValue("max_score").getDouble());
+        benchmark::DoNotOptimize(source.getValue("price").getFloat());
+        benchmark::DoNotOptimize(source.getValue("quantity").getInt());
+        benchmark::DoNotOptimize(source.getValue("quantity").getUnsignedInt());
+    }
+
+    state.SetItemsProcessed(state.iterations() * 5);
+}
+BENCHMARK(BM_NumericGetters);
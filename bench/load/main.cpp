@@ -0,0 +1,252 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Load generator: throughput and latency percentiles of the client under a growing number of threads,
+ * against the embedded mock server or a real cluster.
+ *
+ * bench/bin/loadgen-release-gnu --threads=1,4,16 --duration=5 --operation=mixed --latency=200
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <random>
+
+#include "elasticsearch/elasticsearch.h"
+#include "http/instrumentation.h"
+#include "mock/server.h"
+
+struct Options {
+    Options() : duration(5), operation("mixed"), documents(1000), compression(0) { threads.push_back(1); threads.push_back(2); threads.push_back(4); threads.push_back(8); threads.push_back(16); }
+
+    std::string url;
+    std::vector<int> threads;
+    int duration;
+    std::string operation;
+    int documents;
+    size_t compression;
+    MockServer::Settings server;
+};
+
+static void usage() {
+    std::cout << "Options:\n"
+              << "  --url=host:port        cluster to load, the embedded mock server if none\n"
+              << "  --threads=1,2,4,8,16   numbers of client threads, one run each\n"
+              << "  --duration=5           seconds of each run\n"
+              << "  --operation=mixed      get, search, index, bulk or mixed\n"
+              << "  --documents=1000       documents indexed before the runs\n"
+              << "  --compression=0        compress the request bodies from this size\n"
+              << "Mock server only:\n"
+              << "  --latency=0            microseconds before each response\n"
+              << "  --jitter=0             random microseconds added to the latency\n"
+              << "  --chunked              chunked responses instead of content-length\n"
+              << "  --no-gzip              never compress the responses\n"
+              << "  --error-rate=0         part of the requests answered with --error-status=503\n"
+              << "  --reset-rate=0         part of the requests whose connection is reset" << std::endl;
+}
+
+// Read the --name=value arguments.
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for(int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        size_t equal = argument.find('=');
+        std::string name = argument.substr(0, equal);
+        std::string value = (equal == std::string::npos) ? std::string() : argument.substr(equal + 1);
+
+        if(name == "--url")
+            options.url = value;
+        else if(name == "--threads") {
+            options.threads.clear();
+            std::istringstream list(value);
+            std::string count;
+            while(std::getline(list, count, ','))
+                options.threads.push_back(std::max(atoi(count.c_str()), 1));
+        }
+        else if(name == "--duration")
+            options.duration = std::max(atoi(value.c_str()), 1);
+        else if(name == "--operation")
+            options.operation = value;
+        else if(name == "--documents")
+            options.documents = std::max(atoi(value.c_str()), 1);
+        else if(name == "--compression")
+            options.compression = strtoul(value.c_str(), 0, 10);
+        else if(name == "--latency")
+            options.server.latency = std::chrono::microseconds(atol(value.c_str()));
+        else if(name == "--jitter")
+            options.server.jitter = std::chrono::microseconds(atol(value.c_str()));
+        else if(name == "--chunked")
+            options.server.chunked = true;
+        else if(name == "--no-gzip")
+            options.server.compression = false;
+        else if(name == "--error-rate")
+            options.server.errorRate = atof(value.c_str());
+        else if(name == "--error-status")
+            options.server.errorStatus = atoi(value.c_str());
+        else if(name == "--reset-rate")
+            options.server.resetRate = atof(value.c_str());
+        else
+            return false;
+    }
+
+    return options.operation == "get" || options.operation == "search" || options.operation == "index" || options.operation == "bulk" || options.operation == "mixed";
+}
+
+// Document of the load, a few fields of each type.
+static Json::Object makeDocument(long number) {
+    Json::Object document;
+    document.addMemberByKey("name", "Document number " + std::to_string(number));
+    document.addMemberByKey("number", number);
+    document.addMemberByKey("price", number * 0.25);
+    document.addMemberByKey("available", number % 2 == 0);
+    return document;
+}
+
+/// Results of one run.
+struct Run {
+    Run() : requests(0), errors(0) {}
+    std::atomic<unsigned long long> requests;
+    std::atomic<unsigned long long> errors;
+    Histogram latencies;
+};
+
+// Send requests until the end of the run, each one timed.
+static void load(ElasticSearch& es, const Options& options, std::chrono::steady_clock::time_point end, std::atomic<long>& nextId, Run& run) {
+    std::mt19937 generator(std::random_device{}());
+    std::uniform_int_distribution<int> documents(0, options.documents - 1);
+    std::uniform_int_distribution<int> operations(0, 9);
+
+    while(std::chrono::steady_clock::now() < end) {
+        std::string operation = options.operation;
+
+        // Mixed: 60% gets, 30% searches, 10% index.
+        if(operation == "mixed") {
+            int draw = operations(generator);
+            operation = (draw < 6) ? "get" : (draw < 9) ? "search" : "index";
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool ok = false;
+
+        try {
+            if(operation == "get") {
+                Json::Object document;
+                ok = es.getDocument("load", "doc", std::to_string(documents(generator)).c_str(), document);
+            }
+            else if(operation == "search") {
+                Json::Object result;
+                ok = es.search("load", "doc", "{\"query\":{\"match_all\":{}},\"size\":10}", result) >= 0;
+            }
+            else if(operation == "index") {
+                long id = nextId++;
+                ok = es.index("load", "doc", std::to_string(id), makeDocument(id));
+            }
+            else {
+                BulkBuilder bulk;
+                for(int i = 0; i < 100; ++i) {
+                    long id = nextId++;
+                    bulk.index("load", "doc", std::to_string(id), makeDocument(id));
+                }
+                Json::Object result;
+                ok = es.bulk(bulk.str().c_str(), result);
+            }
+        }
+        catch(Exception&) {
+            ok = false;
+        }
+
+        run.latencies.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        ++run.requests;
+        if(!ok)
+            ++run.errors;
+    }
+}
+
+int main(int argc, char** argv) {
+
+    Options options;
+    if(!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    // The injected errors would flood the output.
+    Logger::setLevel(LogLevel::ERROR);
+
+    std::unique_ptr<MockServer> server;
+    if(options.url.empty()) {
+        server.reset(new MockServer());
+        options.url = server->url();
+    }
+
+    ElasticSearch es(options.url);
+    es.setCompression(options.compression);
+
+    // Documents read by the gets and the searches.
+    BulkBuilder bulk;
+    for(long i = 0; i < options.documents; ++i)
+        bulk.index("load", "doc", std::to_string(i), makeDocument(i));
+    Json::Object result;
+    if(!es.bulk(bulk.str().c_str(), result)) {
+        std::cerr << "Cannot index the documents of the load." << std::endl;
+        return 1;
+    }
+    es.refresh("load");
+
+    // Latency and errors are injected once the documents are loaded.
+    if(server)
+        server->setSettings(options.server);
+
+    std::atomic<long> nextId(options.documents);
+
+    std::cout << "Operation " << options.operation << " on " << options.url << ", " << options.duration << "s per run" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "requests" << std::setw(10) << "errors" << std::setw(12) << "req/s"
+              << std::setw(10) << "p50 us" << std::setw(10) << "p90 us" << std::setw(10) << "p99 us" << std::setw(10) << "p99.9 us" << std::setw(10) << "max us" << std::endl;
+
+    for(int threadCount : options.threads) {
+        Run run;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point end = start + std::chrono::seconds(options.duration);
+
+        std::vector<std::thread> threads;
+        for(int i = 0; i < threadCount; ++i)
+            threads.push_back(std::thread(load, std::ref(es), std::cref(options), end, std::ref(nextId), std::ref(run)));
+        for(std::thread& thread : threads)
+            thread.join();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::setw(8) << threadCount << std::setw(12) << run.requests << std::setw(10) << run.errors
+                  << std::setw(12) << std::fixed << std::setprecision(0) << run.requests / seconds
+                  << std::setw(10) << run.latencies.percentile(50.) / 1000 << std::setw(10) << run.latencies.percentile(90.) / 1000
+                  << std::setw(10) << run.latencies.percentile(99.) / 1000 << std::setw(10) << run.latencies.percentile(99.9) / 1000
+                  << std::setw(10) << run.latencies.max() / 1000 << std::endl;
+    }
+
+    HTTPStats stats = es.httpStats();
+    std::cout << "Connections opened " << stats.connectionsOpened << ", reused " << stats.connectionsReused << ", failed " << stats.connectionsFailed
+              << ", retries " << stats.retries << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Run the benchmarks, the results are also written as JSON to track the regressions:
+ * bench/bin/bench-release-gnu --benchmark_out=results.json
+ * bench-results.json is written when no output file is given, as JSON unless another format is given.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <vector>
+
+int main(int argc, char** argv) {
+
+    std::vector<char*> arguments(argv, argv + argc);
+
+    bool output = false;
+    bool format = false;
+    for(int i = 1; i < argc; ++i) {
+        if(strncmp(argv[i], "--benchmark_out=", 16) == 0)
+            output = true;
+        if(strncmp(argv[i], "--benchmark_out_format=", 23) == 0)
+            format = true;
+    }
+
+    static char defaultOutput[] = "--benchmark_out=bench-results.json";
+    static char jsonFormat[] = "--benchmark_out_format=json";
+    if(!output)
+        arguments.push_back(defaultOutput);
+    if(!format)
+        arguments.push_back(jsonFormat);
+
+    int count = arguments.size();
+    benchmark::Initialize(&count, arguments.data());
+    if(benchmark::ReportUnrecognizedArguments(count, arguments.data()))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,895 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Embedded Elasticsearch mock for the load tests, speaks enough of the REST API for the client.
+*/
+
+#include "server.h"
+
+#include "http/http.h"
+#include "json/json.h"
+
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+
+/// Size of the reads on the connections.
+#define MOCK_READ_SIZE 16384
+
+/// Hits returned by a search without size.
+#define MOCK_DEFAULT_SIZE 10
+
+// Random number in [0, 1) of the thread.
+static double uniform() {
+    static thread_local std::mt19937 generator(std::random_device{}());
+    return std::uniform_real_distribution<double>(0., 1.)(generator);
+}
+
+// Split the text on the separator, empty parts dropped.
+static std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    while(begin <= text.size()) {
+        size_t end = text.find(separator, begin);
+        if(end == std::string::npos)
+            end = text.size();
+        if(end > begin)
+            parts.push_back(text.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return parts;
+}
+
+// Json string literal.
+static std::string quote(const std::string& text) {
+    return "\"" + Json::Value::escapeJsonString(text) + "\"";
+}
+
+// Member of a parsed object as a string, empty if missing.
+static std::string member(const Json::Object& object, const std::string& key) {
+    if(!object.member(key) || object[key].isNull())
+        return std::string();
+    return object[key].getString();
+}
+
+// Parse a Json body, empty object if there is none.
+static void parse(const std::string& text, Json::Object& object) {
+    size_t begin = text.find('{');
+    if(begin != std::string::npos)
+        object.addMember(text.c_str() + begin, text.c_str() + text.size());
+}
+
+static const char* reason(unsigned int status) {
+    switch(status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return "Unknown";
+    }
+}
+
+// Gzip the body.
+static std::string gzip(const std::string& body) {
+    z_stream stream = z_stream();
+    if(deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        EXCEPTION("Cannot initialize gzip.");
+
+    std::string compressed(deflateBound(&stream, body.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream.avail_in = body.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return compressed;
+}
+
+// Inflate a gzip or deflate body.
+static std::string inflate(const std::string& body) {
+    z_stream stream = z_stream();
+    if(inflateInit2(&stream, 15 + 32) != Z_OK)
+        EXCEPTION("Cannot initialize inflate.");
+
+    std::string output;
+    char buffer[MOCK_READ_SIZE];
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream.avail_in = body.size();
+
+    int ret = Z_OK;
+    while(ret == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        ret = ::inflate(&stream, Z_NO_FLUSH);
+        output.append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+
+    if(ret != Z_STREAM_END)
+        EXCEPTION("Corrupted compressed body.");
+
+    return output;
+}
+
+MockServer::MockServer(int port, const Settings& settings)
+: _listenFd(-1),
+  _port(port),
+  _stop(false),
+  _requests(0),
+  _nextId(0),
+  _settings(settings)
+{
+    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if(_listenFd < 0)
+        EXCEPTION("Mock server cannot create its socket.");
+
+    int reuse = 1;
+    setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    socklen_t length = sizeof(address);
+    if(bind(_listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(_listenFd, 128) < 0 || getsockname(_listenFd, (struct sockaddr*)&address, &length) < 0) {
+        close(_listenFd);
+        EXCEPTION("Mock server cannot listen on port " + std::to_string(port) + ".");
+    }
+
+    _port = ntohs(address.sin_port);
+    _acceptor = std::thread(&MockServer::acceptLoop, this);
+}
+
+// Stop accepting, close the connections and wait for their threads.
+MockServer::~MockServer() {
+    _stop = true;
+    shutdown(_listenFd, SHUT_RDWR);
+    _acceptor.join();
+    close(_listenFd);
+
+    {
+        std::lock_guard<std::mutex> lock(_connectionsMutex);
+        for(int fd : _connections)
+            shutdown(fd, SHUT_RDWR);
+    }
+
+    for(std::thread& worker : _workers)
+        worker.join();
+}
+
+// Url of the server for the client.
+std::string MockServer::url() const {
+    return "127.0.0.1:" + std::to_string(_port);
+}
+
+void MockServer::setSettings(const Settings& settings) {
+    std::lock_guard<std::mutex> lock(_settingsMutex);
+    _settings = settings;
+}
+
+MockServer::Settings MockServer::settings() const {
+    std::lock_guard<std::mutex> lock(_settingsMutex);
+    return _settings;
+}
+
+// Remove every document.
+void MockServer::clear() {
+    std::lock_guard<std::mutex> lock(_dataMutex);
+    _indices.clear();
+    _scrolls.clear();
+}
+
+// Serve each new connection on its own thread.
+void MockServer::acceptLoop() {
+    while(!_stop) {
+        int fd = accept(_listenFd, 0, 0);
+        if(fd < 0) {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        std::lock_guard<std::mutex> lock(_connectionsMutex);
+        if(_stop) {
+            close(fd);
+            break;
+        }
+
+        _connections.insert(fd);
+        _workers.push_back(std::thread(&MockServer::serve, this, fd));
+    }
+}
+
+// Answer the requests of a connection until it is closed.
+void MockServer::serve(int fd) {
+    std::string buffer;
+    Request request;
+
+    try {
+        while(!_stop && readRequest(fd, buffer, request)) {
+            Settings settings = this->settings();
+
+            if(settings.resetRate > 0. && uniform() < settings.resetRate)
+                break;
+
+            Response response;
+            if(settings.errorRate > 0. && uniform() < settings.errorRate) {
+                response.status = settings.errorStatus;
+                response.body = "{\"error\":{\"type\":\"es_rejected_execution_exception\",\"reason\":\"injected error\"},\"status\":" + std::to_string(settings.errorStatus) + "}";
+            }
+            else
+                response = handle(request);
+
+            long long delay = settings.latency.count();
+            if(settings.jitter.count() > 0)
+                delay += static_cast<long long>(uniform() * settings.jitter.count());
+            if(delay > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(delay));
+
+            _requests.fetch_add(1, std::memory_order_relaxed);
+
+            if(!writeResponse(fd, request, response, settings))
+                break;
+
+            std::map<std::string, std::string>::const_iterator connection = request.headers.find("connection");
+            if(connection != request.headers.end() && strcasecmp(connection->second.c_str(), "close") == 0)
+                break;
+        }
+    }
+    catch(Exception&) {
+        // Malformed request, drop the connection.
+    }
+
+    std::lock_guard<std::mutex> lock(_connectionsMutex);
+    _connections.erase(fd);
+    close(fd);
+}
+
+// Read one request: headers, then the body delimited by its length or chunked, inflated if compressed.
+bool MockServer::readRequest(int fd, std::string& buffer, Request& request) {
+    char data[MOCK_READ_SIZE];
+
+    size_t headerEnd;
+    while((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t size = recv(fd, data, sizeof(data), 0);
+        if(size <= 0)
+            return false;
+        buffer.append(data, size);
+    }
+
+    request = Request();
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    while(begin < headerEnd) {
+        size_t end = buffer.find("\r\n", begin);
+        lines.push_back(buffer.substr(begin, end - begin));
+        begin = end + 2;
+    }
+
+    std::vector<std::string> requestLine = split(lines.empty() ? std::string() : lines[0], ' ');
+    if(requestLine.size() != 3)
+        EXCEPTION("Malformed request line.");
+
+    request.method = requestLine[0];
+
+    std::string target = requestLine[1];
+    size_t query = target.find('?');
+    request.path = target.substr(0, query);
+    if(query != std::string::npos) {
+        for(const std::string& parameter : split(target.substr(query + 1), '&')) {
+            size_t equal = parameter.find('=');
+            request.parameters[parameter.substr(0, equal)] = (equal == std::string::npos) ? std::string() : parameter.substr(equal + 1);
+        }
+    }
+
+    for(size_t i = 1; i < lines.size(); ++i) {
+        size_t colon = lines[i].find(':');
+        if(colon == std::string::npos)
+            continue;
+
+        std::string name = lines[i].substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        size_t value = lines[i].find_first_not_of(' ', colon + 1);
+        request.headers[name] = (value == std::string::npos) ? std::string() : lines[i].substr(value);
+    }
+
+    buffer.erase(0, headerEnd + 4);
+
+    // Body delimited by the chunks.
+    std::map<std::string, std::string>::const_iterator header = request.headers.find("transfer-encoding");
+    if(header != request.headers.end() && strcasestr(header->second.c_str(), "chunked") != 0) {
+        while(true) {
+            size_t lineEnd;
+            while((lineEnd = buffer.find("\r\n")) == std::string::npos) {
+                ssize_t size = recv(fd, data, sizeof(data), 0);
+                if(size <= 0)
+                    return false;
+                buffer.append(data, size);
+            }
+
+            size_t chunkSize = strtoul(buffer.c_str(), 0, 16);
+            while(buffer.size() < lineEnd + 2 + chunkSize + 2) {
+                ssize_t size = recv(fd, data, sizeof(data), 0);
+                if(size <= 0)
+                    return false;
+                buffer.append(data, size);
+            }
+
+            request.body.append(buffer, lineEnd + 2, chunkSize);
+            buffer.erase(0, lineEnd + 2 + chunkSize + 2);
+
+            if(chunkSize == 0)
+                break;
+        }
+    }
+    // Body delimited by its length.
+    else {
+        header = request.headers.find("content-length");
+        size_t length = (header == request.headers.end()) ? 0 : strtoul(header->second.c_str(), 0, 10);
+
+        while(buffer.size() < length) {
+            ssize_t size = recv(fd, data, sizeof(data), 0);
+            if(size <= 0)
+                return false;
+            buffer.append(data, size);
+        }
+
+        request.body = buffer.substr(0, length);
+        buffer.erase(0, length);
+    }
+
+    header = request.headers.find("content-encoding");
+    if(header != request.headers.end() && (header->second == "gzip" || header->second == "deflate"))
+        request.body = inflate(request.body);
+
+    return true;
+}
+
+// Write the response, compressed and chunked as set.
+bool MockServer::writeResponse(int fd, const Request& request, const Response& response, const Settings& settings) {
+    std::string body = response.body;
+
+    std::ostringstream head;
+    head << "HTTP/1.1 " << response.status << " " << reason(response.status) << "\r\n";
+    head << "content-type: application/json; charset=UTF-8\r\n";
+
+    std::map<std::string, std::string>::const_iterator accept = request.headers.find("accept-encoding");
+    if(settings.compression && !body.empty() && accept != request.headers.end() && accept->second.find("gzip") != std::string::npos) {
+        body = gzip(body);
+        head << "content-encoding: gzip\r\n";
+    }
+
+    bool head_ = (request.method == "HEAD");
+    std::string output;
+
+    if(settings.chunked && !head_) {
+        head << "transfer-encoding: chunked\r\n\r\n";
+        output = head.str();
+
+        char size[24];
+        size_t chunkSize = std::max<size_t>(settings.chunkSize, 1);
+        for(size_t offset = 0; offset < body.size(); offset += chunkSize) {
+            size_t length = std::min(chunkSize, body.size() - offset);
+            snprintf(size, sizeof(size), "%zx\r\n", length);
+            output += size;
+            output.append(body, offset, length);
+            output += "\r\n";
+        }
+        output += "0\r\n\r\n";
+    }
+    else {
+        head << "content-length: " << body.size() << "\r\n\r\n";
+        output = head.str();
+        if(!head_)
+            output += body;
+    }
+
+    size_t written = 0;
+    while(written < output.size()) {
+        ssize_t size = send(fd, output.data() + written, output.size() - written, MSG_NOSIGNAL);
+        if(size <= 0)
+            return false;
+        written += size;
+    }
+
+    return true;
+}
+
+// Route the request on the elements of its path.
+MockServer::Response MockServer::handle(const Request& request) {
+    std::vector<std::string> path = split(request.path, '/');
+
+    if(path.empty())
+        return info(request);
+
+    // Position of the first endpoint of the path, after the index and type.
+    size_t endpoint = 0;
+    while(endpoint < path.size() && path[endpoint][0] != '_')
+        ++endpoint;
+
+    std::string index = (endpoint > 0) ? path[0] : std::string();
+    std::string name = (endpoint < path.size()) ? path[endpoint] : std::string();
+
+    if(name == "_search" && endpoint + 1 < path.size() && path[endpoint + 1] == "scroll")
+        return scroll(request);
+    if(name == "_search")
+        return search(request, index, request.body);
+    if(name == "_count")
+        return count(index);
+    if(name == "_bulk")
+        return bulk(request, index);
+    if(name == "_mget")
+        return mget(request, index);
+    if(name == "_msearch")
+        return msearch(request, index);
+    if(name == "_update" && endpoint == 3)
+        return update(request, path[0], path[1], path[2]);
+
+    // Documents by index/type/id, or index/_doc/id.
+    if(endpoint == 3 || (endpoint == 1 && name == "_doc" && path.size() == 3))
+        return document(request, path[0], path[1], path[2]);
+    if(endpoint == 2 && path.size() == 2 && request.method == "POST")
+        return document(request, path[0], path[1], std::string());
+
+    Response response;
+
+    // Indices.
+    if(endpoint == 1 && path.size() == 1) {
+        std::lock_guard<std::mutex> lock(_dataMutex);
+
+        if(request.method == "HEAD" || request.method == "GET") {
+            response.status = _indices.count(index) ? 200 : 404;
+            if(request.method == "GET")
+                response.body = "{" + quote(index) + ":{\"settings\":{}}}";
+            return response;
+        }
+
+        if(request.method == "DELETE")
+            _indices.erase(index);
+        else
+            _indices[index];
+    }
+
+    if(name == "_pit") {
+        response.body = "{\"id\":\"pit-" + std::to_string(++_nextId) + "\"}";
+        return response;
+    }
+
+    // Refresh, mappings and the other administration calls.
+    response.body = "{\"acknowledged\":true}";
+    return response;
+}
+
+// Description of the node.
+MockServer::Response MockServer::info(const Request& request) {
+    Response response;
+    if(request.method != "HEAD")
+        response.body = "{\"name\":\"mock\",\"cluster_name\":\"mock\",\"version\":{\"number\":\"6.8.0\",\"lucene_version\":\"7.7.0\"},\"tagline\":\"You Know, for Search\"}";
+    return response;
+}
+
+// Store a document and return its version.
+long MockServer::put(const std::string& index, const std::string& type, const std::string& id, const std::string& source) {
+    Document& document = _indices[index][id];
+    document.type = type;
+    document.source = source.empty() ? "{}" : source;
+    return ++document.version;
+}
+
+// Json of a document as returned by a get.
+std::string MockServer::getResult(const std::string& index, const std::string& type, const std::string& id) const {
+    std::ostringstream out;
+    out << "{\"_index\":" << quote(index) << ",\"_type\":" << quote(type) << ",\"_id\":" << quote(id);
+
+    Indices::const_iterator documents = _indices.find(index);
+    std::map<std::string, Document>::const_iterator document;
+    if(documents == _indices.end() || (document = documents->second.find(id)) == documents->second.end()) {
+        out << ",\"found\":false}";
+        return out.str();
+    }
+
+    out << ",\"_version\":" << document->second.version << ",\"found\":true,\"_source\":" << document->second.source << "}";
+    return out.str();
+}
+
+// Json of one hit.
+std::string MockServer::hit(const std::string& index, const std::string& id, const Document& document) {
+    return "{\"_index\":" + quote(index) + ",\"_type\":" + quote(document.type) + ",\"_id\":" + quote(id) + ",\"_score\":1.0,\"_source\":" + document.source + "}";
+}
+
+// Get, test, index or delete a document.
+MockServer::Response MockServer::document(const Request& request, const std::string& index, const std::string& type, const std::string& id) {
+    Response response;
+    std::lock_guard<std::mutex> lock(_dataMutex);
+
+    if(request.method == "GET" || request.method == "HEAD") {
+        response.body = getResult(index, type, id);
+        Indices::const_iterator documents = _indices.find(index);
+        if(documents == _indices.end() || documents->second.count(id) == 0)
+            response.status = 404;
+        if(request.method == "HEAD")
+            response.body.clear();
+        return response;
+    }
+
+    if(request.method == "PUT" || request.method == "POST") {
+        std::string documentId = id.empty() ? "mock" + std::to_string(++_nextId) : id;
+        bool created = (_indices[index].count(documentId) == 0);
+        long version = put(index, type, documentId, request.body);
+
+        response.status = created ? 201 : 200;
+        response.body = "{\"_index\":" + quote(index) + ",\"_type\":" + quote(type) + ",\"_id\":" + quote(documentId) + ",\"_version\":" + std::to_string(version)
+                      + ",\"result\":\"" + (created ? "created" : "updated") + "\",\"_shards\":{\"total\":2,\"successful\":1,\"failed\":0},\"created\":" + (created ? "true" : "false") + "}";
+        return response;
+    }
+
+    if(request.method == "DELETE") {
+        Indices::iterator documents = _indices.find(index);
+        std::map<std::string, Document>::iterator document;
+        if(documents == _indices.end() || (document = documents->second.find(id)) == documents->second.end()) {
+            response.status = 404;
+            response.body = "{\"found\":false,\"_index\":" + quote(index) + ",\"_type\":" + quote(type) + ",\"_id\":" + quote(id) + ",\"result\":\"not_found\"}";
+            return response;
+        }
+
+        long version = document->second.version + 1;
+        documents->second.erase(document);
+        response.body = "{\"found\":true,\"_index\":" + quote(index) + ",\"_type\":" + quote(type) + ",\"_id\":" + quote(id) + ",\"_version\":" + std::to_string(version) + ",\"result\":\"deleted\"}";
+        return response;
+    }
+
+    response.status = 400;
+    response.body = "{\"error\":\"unsupported method\",\"status\":400}";
+    return response;
+}
+
+// Merge the fields of doc into the document, created with upsert or doc_as_upsert if missing.
+MockServer::Response MockServer::update(const Request& request, const std::string& index, const std::string& type, const std::string& id) {
+    Json::Object body;
+    parse(request.body, body);
+
+    Response response;
+    std::lock_guard<std::mutex> lock(_dataMutex);
+
+    std::map<std::string, Document>& documents = _indices[index];
+    std::map<std::string, Document>::iterator document = documents.find(id);
+
+    if(document == documents.end()) {
+        std::string source;
+        if(body.member("upsert"))
+            source = body["upsert"].getObject().str();
+        else if(body.member("doc_as_upsert") && body["doc_as_upsert"].getBoolean() && body.member("doc"))
+            source = body["doc"].getObject().str();
+        else {
+            response.status = 404;
+            response.body = "{\"error\":{\"type\":\"document_missing_exception\"},\"status\":404}";
+            return response;
+        }
+
+        long version = put(index, type, id, source);
+        response.body = "{\"_index\":" + quote(index) + ",\"_type\":" + quote(type) + ",\"_id\":" + quote(id) + ",\"_version\":" + std::to_string(version) + ",\"result\":\"created\"}";
+        return response;
+    }
+
+    if(body.member("doc")) {
+        Json::Object source;
+        parse(document->second.source, source);
+        const Json::Object& doc = body["doc"].getObject();
+
+        std::ostringstream merged;
+        merged << "{";
+        bool first = true;
+        for(Json::Object::const_iterator it = source.begin(); it != source.end(); ++it) {
+            if(doc.member(it.key()))
+                continue;
+            merged << (first ? "" : ",") << quote(it.key()) << ":" << it.value();
+            first = false;
+        }
+        for(Json::Object::const_iterator it = doc.begin(); it != doc.end(); ++it) {
+            merged << (first ? "" : ",") << quote(it.key()) << ":" << it.value();
+            first = false;
+        }
+        merged << "}";
+
+        document->second.source = merged.str();
+    }
+
+    long version = ++document->second.version;
+    response.body = "{\"_index\":" + quote(index) + ",\"_type\":" + quote(type) + ",\"_id\":" + quote(id) + ",\"_version\":" + std::to_string(version) + ",\"result\":\"updated\"}";
+    return response;
+}
+
+// Every document of the index matches, or of every index if none.
+MockServer::Response MockServer::search(const Request& request, const std::string& index, const std::string& body) {
+    Json::Object query;
+    parse(body, query);
+
+    size_t size = MOCK_DEFAULT_SIZE;
+    size_t from = 0;
+    std::map<std::string, std::string>::const_iterator parameter = request.parameters.find("size");
+    if(parameter != request.parameters.end())
+        size = strtoul(parameter->second.c_str(), 0, 10);
+    else if(query.member("size"))
+        size = query["size"].getUnsignedInt();
+    if(query.member("from"))
+        from = query["from"].getUnsignedInt();
+
+    // Only the hits of the page are built, all of them for a scroll.
+    bool scrolled = (request.parameters.count("scroll") > 0);
+    std::vector<std::string> hits;
+    size_t total = 0;
+    {
+        std::lock_guard<std::mutex> lock(_dataMutex);
+        for(Indices::const_iterator documents = _indices.begin(); documents != _indices.end(); ++documents) {
+            if(!index.empty() && documents->first != index)
+                continue;
+            for(std::map<std::string, Document>::const_iterator document = documents->second.begin(); document != documents->second.end(); ++document, ++total)
+                if(scrolled || (total >= from && total < from + size))
+                    hits.push_back(hit(documents->first, document->first, document->second));
+        }
+    }
+
+    Response response;
+    std::ostringstream out;
+    out << "{";
+
+    // The first page of a scroll is kept for the next calls, a scan returns no hit at first.
+    size_t first = std::min(from, total);
+    size_t last = std::min(first + size, total);
+    bool scan = (request.parameters.count("search_type") && request.parameters.find("search_type")->second == "scan");
+
+    if(scrolled) {
+        std::string id = "scroll-" + std::to_string(++_nextId);
+        Scroll scroll;
+        scroll.size = size;
+        scroll.offset = scan ? 0 : last;
+        scroll.hits.swap(hits);
+
+        std::lock_guard<std::mutex> lock(_dataMutex);
+        std::vector<std::string>& stored = (_scrolls[id] = scroll).hits;
+        out << "\"_scroll_id\":" << quote(id) << ",";
+
+        if(scan)
+            last = first;
+
+        out << "\"took\":1,\"timed_out\":false,\"_shards\":{\"total\":1,\"successful\":1,\"skipped\":0,\"failed\":0},\"hits\":{\"total\":" << total << ",\"max_score\":1.0,\"hits\":[";
+        for(size_t i = first; i < last; ++i)
+            out << (i > first ? "," : "") << stored[i];
+    }
+    else {
+        out << "\"took\":1,\"timed_out\":false,\"_shards\":{\"total\":1,\"successful\":1,\"skipped\":0,\"failed\":0},\"hits\":{\"total\":" << total << ",\"max_score\":1.0,\"hits\":[";
+        for(size_t i = 0; i < hits.size(); ++i)
+            out << (i > 0 ? "," : "") << hits[i];
+    }
+
+    out << "]}}";
+    response.body = out.str();
+    return response;
+}
+
+// Next page of a scroll, or clear it.
+MockServer::Response MockServer::scroll(const Request& request) {
+    Response response;
+
+    // The scroll id is sent raw or in a Json body.
+    std::string id = request.body;
+    if(!id.empty() && id[0] == '{') {
+        Json::Object body;
+        parse(request.body, body);
+        id = member(body, "scroll_id");
+    }
+
+    std::lock_guard<std::mutex> lock(_dataMutex);
+    std::map<std::string, Scroll>::iterator scroll = _scrolls.find(id);
+
+    if(request.method == "DELETE") {
+        if(scroll != _scrolls.end())
+            _scrolls.erase(scroll);
+        response.body = "{\"succeeded\":true,\"num_freed\":1}";
+        return response;
+    }
+
+    if(scroll == _scrolls.end()) {
+        response.status = 404;
+        response.body = "{\"error\":{\"type\":\"search_context_missing_exception\"},\"status\":404}";
+        return response;
+    }
+
+    size_t first = scroll->second.offset;
+    size_t last = std::min(first + scroll->second.size, scroll->second.hits.size());
+    scroll->second.offset = last;
+
+    std::ostringstream out;
+    out << "{\"_scroll_id\":" << quote(id) << ",\"took\":1,\"timed_out\":false,\"hits\":{\"total\":" << scroll->second.hits.size() << ",\"max_score\":1.0,\"hits\":[";
+    for(size_t i = first; i < last; ++i)
+        out << (i > first ? "," : "") << scroll->second.hits[i];
+    out << "]}}";
+
+    response.body = out.str();
+    return response;
+}
+
+// Number of documents of the index, or of every index.
+MockServer::Response MockServer::count(const std::string& index) {
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(_dataMutex);
+        for(Indices::const_iterator documents = _indices.begin(); documents != _indices.end(); ++documents)
+            if(index.empty() || documents->first == index)
+                count += documents->second.size();
+    }
+
+    Response response;
+    response.body = "{\"count\":" + std::to_string(count) + ",\"_shards\":{\"total\":1,\"successful\":1,\"skipped\":0,\"failed\":0}}";
+    return response;
+}
+
+// Apply the index, create, update and delete actions, one Json per line.
+MockServer::Response MockServer::bulk(const Request& request, const std::string& index) {
+    std::vector<std::string> lines = split(request.body, '\n');
+
+    std::ostringstream out;
+    out << "{\"took\":1,\"errors\":false,\"items\":[";
+
+    std::lock_guard<std::mutex> lock(_dataMutex);
+    bool first = true;
+    for(size_t i = 0; i < lines.size(); ++i) {
+        Json::Object action;
+        parse(lines[i], action);
+        if(action.empty())
+            continue;
+
+        const std::string& name = action.begin().key();
+        const Json::Object& metadata = action.begin().value().getObject();
+
+        std::string documentIndex = metadata.member("_index") ? member(metadata, "_index") : index;
+        std::string type = metadata.member("_type") ? member(metadata, "_type") : "_doc";
+        std::string id = member(metadata, "_id");
+        if(id.empty())
+            id = "mock" + std::to_string(++_nextId);
+
+        std::string source = (name != "delete" && i + 1 < lines.size()) ? lines[++i] : std::string();
+
+        unsigned int status = 200;
+        std::string result = "updated";
+        long version = 1;
+
+        if(name == "delete") {
+            std::map<std::string, Document>& documents = _indices[documentIndex];
+            status = documents.erase(id) ? 200 : 404;
+            result = (status == 200) ? "deleted" : "not_found";
+        }
+        else if(name == "update") {
+            // Only partial documents are supported, the fields replace the whole source.
+            Json::Object body;
+            parse(source, body);
+            std::map<std::string, Document>& documents = _indices[documentIndex];
+            if(documents.count(id) || body.member("upsert") || body.member("doc_as_upsert")) {
+                version = put(documentIndex, type, id, body.member("doc") ? body["doc"].getObject().str() : source);
+            }
+            else {
+                status = 404;
+                result = "not_found";
+            }
+        }
+        else {
+            bool created = (_indices[documentIndex].count(id) == 0);
+            version = put(documentIndex, type, id, source);
+            status = created ? 201 : 200;
+            result = created ? "created" : "updated";
+        }
+
+        out << (first ? "" : ",") << "{" << quote(name) << ":{\"_index\":" << quote(documentIndex) << ",\"_type\":" << quote(type) << ",\"_id\":" << quote(id)
+            << ",\"_version\":" << version << ",\"result\":" << quote(result) << ",\"status\":" << status << "}}";
+        first = false;
+    }
+
+    out << "]}";
+
+    Response response;
+    response.body = out.str();
+    return response;
+}
+
+// Documents by ids of the index, or by index, type and id.
+MockServer::Response MockServer::mget(const Request& request, const std::string& index) {
+    Json::Object body;
+    parse(request.body, body);
+
+    std::vector<std::string> path = split(request.path, '/');
+    std::string type = (path.size() == 3) ? path[1] : "_doc";
+
+    std::ostringstream out;
+    out << "{\"docs\":[";
+
+    std::lock_guard<std::mutex> lock(_dataMutex);
+    bool first = true;
+
+    if(body.member("ids")) {
+        for(const Json::Value& id : body["ids"].getArray()) {
+            out << (first ? "" : ",") << getResult(index, type, id.getString());
+            first = false;
+        }
+    }
+
+    if(body.member("docs")) {
+        for(const Json::Value& value : body["docs"].getArray()) {
+            const Json::Object& doc = value.getObject();
+            std::string documentIndex = doc.member("_index") ? member(doc, "_index") : index;
+            std::string documentType = doc.member("_type") ? member(doc, "_type") : type;
+            out << (first ? "" : ",") << getResult(documentIndex, documentType, member(doc, "_id"));
+            first = false;
+        }
+    }
+
+    out << "]}";
+
+    Response response;
+    response.body = out.str();
+    return response;
+}
+
+// Searches by pairs of header and body lines.
+MockServer::Response MockServer::msearch(const Request& request, const std::string& index) {
+    std::vector<std::string> lines = split(request.body, '\n');
+
+    Request search;
+    std::ostringstream out;
+    out << "{\"responses\":[";
+
+    for(size_t i = 0; i + 1 < lines.size(); i += 2) {
+        Json::Object header;
+        parse(lines[i], header);
+
+        std::string searchIndex = header.member("index") ? member(header, "index") : index;
+        Response response = this->search(search, searchIndex, lines[i + 1]);
+
+        // Each response carries its status.
+        response.body.insert(response.body.size() - 1, ",\"status\":200");
+        out << (i > 0 ? "," : "") << response.body;
+    }
+
+    out << "]}";
+
+    Response response;
+    response.body = out.str();
+    return response;
+}
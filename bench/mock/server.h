@@ -0,0 +1,162 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Embedded Elasticsearch mock for the load tests, speaks enough of the REST API for the client.
+*/
+
+#ifndef MOCK_SERVER_H
+#define MOCK_SERVER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+/// HTTP/1.1 server on the loopback answering like a single node Elasticsearch 6 cluster, documents kept in memory:
+/// /, documents GET/HEAD/PUT/POST/DELETE and _update, _search, _search/scroll, _bulk, _count, _mget and _msearch.
+/// Other endpoints are acknowledged. A thread serves each connection, keep-alive is supported.
+class MockServer {
+    public:
+        struct Settings {
+            Settings() : latency(0), jitter(0), chunked(false), chunkSize(8192), compression(true), errorRate(0.), errorStatus(503), resetRate(0.) {}
+
+            /// Delay before each response, plus a random part up to jitter.
+            std::chrono::microseconds latency;
+            std::chrono::microseconds jitter;
+
+            /// Send the bodies chunked instead of with a content-length.
+            bool chunked;
+            size_t chunkSize;
+
+            /// Gzip the response bodies when the client accepts it.
+            bool compression;
+
+            /// Part of the requests answered with the error status, and part of the connections reset instead of answered.
+            double errorRate;
+            unsigned int errorStatus;
+            double resetRate;
+        };
+
+        /// Listen on the port of the loopback, 0 for any free port.
+        explicit MockServer(int port = 0, const Settings& settings = Settings());
+        ~MockServer();
+
+        /// Url of the server for the client.
+        std::string url() const;
+        inline int port() const { return _port; }
+
+        /// Change the behaviour for the next requests.
+        void setSettings(const Settings& settings);
+        Settings settings() const;
+
+        /// Requests answered so far.
+        inline unsigned long long requests() const { return _requests.load(std::memory_order_relaxed); }
+
+        /// Remove every document.
+        void clear();
+
+    private:
+        struct Request {
+            std::string method;
+            std::string path;
+            std::map<std::string, std::string> parameters;
+            std::map<std::string, std::string> headers;
+            std::string body;
+        };
+
+        struct Response {
+            Response() : status(200) {}
+            unsigned int status;
+            std::string body;
+        };
+
+        struct Document {
+            Document() : version(0) {}
+            std::string type;
+            std::string source;
+            long version;
+        };
+
+        /// Documents by id in each index.
+        typedef std::map< std::string, std::map<std::string, Document> > Indices;
+
+        /// Hits of a scroll not returned yet.
+        struct Scroll {
+            std::vector<std::string> hits;
+            size_t offset;
+            size_t size;
+        };
+
+        MockServer(const MockServer&) = delete;
+        MockServer& operator=(const MockServer&) = delete;
+
+        void acceptLoop();
+        void serve(int fd);
+
+        /// Read one request, false when the connection is closed.
+        bool readRequest(int fd, std::string& buffer, Request& request);
+        bool writeResponse(int fd, const Request& request, const Response& response, const Settings& settings);
+
+        Response handle(const Request& request);
+        Response info(const Request& request);
+        Response document(const Request& request, const std::string& index, const std::string& type, const std::string& id);
+        Response update(const Request& request, const std::string& index, const std::string& type, const std::string& id);
+        Response search(const Request& request, const std::string& index, const std::string& body);
+        Response scroll(const Request& request);
+        Response count(const std::string& index);
+        Response bulk(const Request& request, const std::string& index);
+        Response mget(const Request& request, const std::string& index);
+        Response msearch(const Request& request, const std::string& index);
+
+        /// Json of a document as returned by a get, the lock must be held.
+        std::string getResult(const std::string& index, const std::string& type, const std::string& id) const;
+
+        /// Json of one hit, the lock must be held.
+        static std::string hit(const std::string& index, const std::string& id, const Document& document);
+
+        /// Store a document and return its version, the lock must be held.
+        long put(const std::string& index, const std::string& type, const std::string& id, const std::string& source);
+
+        int _listenFd;
+        int _port;
+
+        std::atomic<bool> _stop;
+        std::atomic<unsigned long long> _requests;
+        std::atomic<unsigned long long> _nextId;
+
+        Settings _settings;
+        mutable std::mutex _settingsMutex;
+
+        Indices _indices;
+        std::map<std::string, Scroll> _scrolls;
+        std::mutex _dataMutex;
+
+        std::thread _acceptor;
+        std::vector<std::thread> _workers;
+        std::set<int> _connections;
+        std::mutex _connectionsMutex;
+};
+
+#endif // MOCK_SERVER_H
@@ -0,0 +1,130 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Realistic Elasticsearch payloads for the benchmarks, generated deterministically.
+*/
+
+#include "payloads.h"
+
+#include <sstream>
+#include <cstdio>
+#include <zlib.h>
+
+// Response of a search, shaped like the ones of Elasticsearch 6.
+std::string searchResponse(size_t hits) {
+    std::ostringstream out;
+    out << "{\"took\":12,\"timed_out\":false,\"_shards\":{\"total\":5,\"successful\":5,\"skipped\":0,\"failed\":0},"
+        << "\"hits\":{\"total\":" << hits * 3 << ",\"max_score\":1.2876821,\"hits\":[";
+
+    for(size_t i = 0; i < hits; ++i) {
+        if(i > 0)
+            out << ",";
+
+        out << "{\"_index\":\"products\",\"_type\":\"product\",\"_id\":\"AV" << 100000 + i << "xK\",\"_score\":" << 1.2876821 - i * 0.0001
+            << ",\"_source\":{\"name\":\"Product number " << i << "\",\"description\":\"A \\\"quoted\\\" description with unicode \\u00e9 and a\\nnew line\","
+            << "\"price\":" << 10 + i % 1000 << "." << i % 100 << ",\"quantity\":" << i % 50 << ",\"available\":" << (i % 3 ? "true" : "false")
+            << ",\"tags\":[\"tag" << i % 7 << "\",\"tag" << i % 11 << "\"],\"created\":\"2015-06-0" << 1 + i % 9 << "T10:00:00Z\",\"vendor\":null}}";
+    }
+
+    out << "]}}";
+    return out.str();
+}
+
+// Response of a bulk request of index operations.
+std::string bulkResponse(size_t items) {
+    std::ostringstream out;
+    out << "{\"took\":30,\"errors\":false,\"items\":[";
+
+    for(size_t i = 0; i < items; ++i) {
+        if(i > 0)
+            out << ",";
+
+        out << "{\"index\":{\"_index\":\"products\",\"_type\":\"product\",\"_id\":\"" << i << "\",\"_version\":1,\"result\":\"created\","
+            << "\"_shards\":{\"total\":2,\"successful\":1,\"failed\":0},\"_seq_no\":" << i << ",\"_primary_term\":1,\"status\":201}}";
+    }
+
+    out << "]}";
+    return out.str();
+}
+
+// Mapping of an index, every fourth field is a text with a keyword sub-field.
+std::string mappingResponse(size_t fields) {
+    static const char* types[] = { "keyword", "long", "date", "text" };
+
+    std::ostringstream out;
+    out << "{\"products\":{\"mappings\":{\"product\":{\"properties\":{";
+
+    for(size_t i = 0; i < fields; ++i) {
+        if(i > 0)
+            out << ",";
+
+        const char* type = types[i % 4];
+        out << "\"field" << i << "\":{\"type\":\"" << type << "\"";
+        if(i % 4 == 3)
+            out << ",\"fields\":{\"raw\":{\"type\":\"keyword\",\"ignore_above\":256}}";
+        out << "}";
+    }
+
+    out << "}}}}}";
+    return out.str();
+}
+
+static const char* headers = "HTTP/1.1 200 OK\r\ncontent-type: application/json; charset=UTF-8\r\n";
+
+// Raw response with a content-length body.
+std::string httpContentLength(const std::string& body) {
+    return std::string(headers) + "content-length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+// Raw response with a chunked body.
+std::string httpChunked(const std::string& body, size_t chunkSize) {
+    std::string out(headers);
+    out += "transfer-encoding: chunked\r\n\r\n";
+
+    char size[24];
+    for(size_t offset = 0; offset < body.size(); offset += chunkSize) {
+        size_t length = std::min(chunkSize, body.size() - offset);
+        snprintf(size, sizeof(size), "%zx\r\n", length);
+        out += size;
+        out.append(body, offset, length);
+        out += "\r\n";
+    }
+
+    out += "0\r\n\r\n";
+    return out;
+}
+
+// Raw response with a gzip body.
+std::string httpGzip(const std::string& body) {
+    z_stream stream = z_stream();
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+    std::string compressed(deflateBound(&stream, body.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream.avail_in = body.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return std::string(headers) + "content-encoding: gzip\r\ncontent-length: " + std::to_string(compressed.size()) + "\r\n\r\n" + compressed;
+}
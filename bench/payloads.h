@@ -0,0 +1,48 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Realistic Elasticsearch payloads for the benchmarks, generated deterministically.
+*/
+
+#ifndef PAYLOADS_H
+#define PAYLOADS_H
+
+#include <string>
+
+/// Response of a search with the given number of hits, each with a small source document.
+std::string searchResponse(size_t hits);
+
+/// Response of a bulk request with the given number of index items.
+std::string bulkResponse(size_t items);
+
+/// Mapping of an index with the given number of fields, some with sub-fields.
+std::string mappingResponse(size_t fields);
+
+/// Raw HTTP/1.1 response with a content-length body.
+std::string httpContentLength(const std::string& body);
+
+/// Raw HTTP/1.1 response with a body split in chunks of the given size.
+std::string httpChunked(const std::string& body, size_t chunkSize);
+
+/// Raw HTTP/1.1 response with a gzip body.
+std::string httpGzip(const std::string& body);
+
+#endif // PAYLOADS_H
@@ -0,0 +1,299 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Differential testing of the Json parser: a strict reference parser and a canonical form of the parsed objects.
+*/
+
+#include "differential.h"
+
+#include <map>
+#include <cstring>
+
+/// Same limit as the parser.
+#define REFERENCE_MAX_DEPTH 512
+
+static void canonical(const Json::Value& value, std::string& output);
+
+// Canonical text of an object.
+static void canonical(const Json::Object& object, std::string& output) {
+    output += "{";
+    bool first = true;
+    for(Json::Object::const_iterator it = object.begin(); it != object.end(); ++it) {
+        if(!first)
+            output += ",";
+        output += "\"" + it.key() + "\":";
+        canonical(it.value(), output);
+        first = false;
+    }
+    output += "}";
+}
+
+// Canonical text of a value.
+static void canonical(const Json::Value& value, std::string& output) {
+    if(value.isObject()) {
+        canonical(value.getObject(), output);
+        return;
+    }
+
+    if(value.isArray()) {
+        output += "[";
+        bool first = true;
+        for(const Json::Value& element : value.getArray()) {
+            if(!first)
+                output += ",";
+            canonical(element, output);
+            first = false;
+        }
+        output += "]";
+        return;
+    }
+
+    if(value.isNull()) {
+        output += "null";
+        return;
+    }
+
+    if(strcmp(value.showType(), "string") == 0)
+        output += "\"" + value.getString() + "\"";
+    else if(strcmp(value.showType(), "number") == 0)
+        output += "n(" + value.data() + ")";
+    else
+        output += value.data();
+}
+
+std::string canonical(const Json::Object& object) {
+    std::string output;
+    canonical(object, output);
+    return output;
+}
+
+namespace {
+
+/// Recursive descent on the grammar of RFC 8259, written for clarity rather than speed.
+class Reference {
+    public:
+        Reference(const char* data, size_t size) : _cursor(data), _end(data + size), _depth(0) {}
+
+        bool document(std::string& output) {
+            whiteSpaces();
+            if(!object(output))
+                return false;
+            whiteSpaces();
+            return _cursor == _end;
+        }
+
+    private:
+        bool more() const { return _cursor < _end; }
+        bool peek(char c) const { return more() && *_cursor == c; }
+
+        void whiteSpaces() {
+            while(more() && (*_cursor == ' ' || *_cursor == '\t' || *_cursor == '\n' || *_cursor == '\r'))
+                ++_cursor;
+        }
+
+        bool expect(char c) {
+            if(!peek(c))
+                return false;
+            ++_cursor;
+            return true;
+        }
+
+        bool value(std::string& output) {
+            whiteSpaces();
+            if(!more())
+                return false;
+
+            switch(*_cursor) {
+                case '{': return object(output);
+                case '[': return array(output);
+                case '"': {
+                    std::string text;
+                    if(!string(text))
+                        return false;
+                    output += "\"" + text + "\"";
+                    return true;
+                }
+                case 't': return literal("true", output);
+                case 'f': return literal("false", output);
+                case 'n': return literal("null", output);
+                default: return number(output);
+            }
+        }
+
+        bool literal(const char* word, std::string& output) {
+            size_t length = strlen(word);
+            if(static_cast<size_t>(_end - _cursor) < length || strncmp(_cursor, word, length) != 0)
+                return false;
+            _cursor += length;
+            output += word;
+            return true;
+        }
+
+        // The text of the string between the quotes, escapes kept as written.
+        bool string(std::string& text) {
+            if(!expect('"'))
+                return false;
+
+            const char* start = _cursor;
+            while(more() && *_cursor != '"') {
+                unsigned char c = *_cursor;
+                if(c < 0x20)
+                    return false;
+
+                if(c == '\\') {
+                    ++_cursor;
+                    if(!more())
+                        return false;
+
+                    char escaped = *_cursor;
+                    if(escaped == 'u') {
+                        for(int i = 0; i < 4; ++i) {
+                            ++_cursor;
+                            if(!more() || !isxdigit(static_cast<unsigned char>(*_cursor)))
+                                return false;
+                        }
+                    }
+                    else if(!strchr("\"\\/bfnrt", escaped) || escaped == '\0')
+                        return false;
+                }
+                ++_cursor;
+            }
+
+            if(!more())
+                return false;
+
+            text.assign(start, _cursor - start);
+            ++_cursor;
+            return true;
+        }
+
+        bool digits() {
+            if(!more() || !isdigit(static_cast<unsigned char>(*_cursor)))
+                return false;
+            while(more() && isdigit(static_cast<unsigned char>(*_cursor)))
+                ++_cursor;
+            return true;
+        }
+
+        bool number(std::string& output) {
+            const char* start = _cursor;
+
+            expect('-');
+            if(peek('0'))
+                ++_cursor;
+            else if(!digits())
+                return false;
+
+            if(expect('.') && !digits())
+                return false;
+
+            if(peek('e') || peek('E')) {
+                ++_cursor;
+                if(peek('+') || peek('-'))
+                    ++_cursor;
+                if(!digits())
+                    return false;
+            }
+
+            output += "n(" + std::string(start, _cursor - start) + ")";
+            return true;
+        }
+
+        bool array(std::string& output) {
+            if(!expect('[') || ++_depth > REFERENCE_MAX_DEPTH)
+                return false;
+
+            output += "[";
+            whiteSpaces();
+            if(!expect(']')) {
+                while(true) {
+                    if(!value(output))
+                        return false;
+                    whiteSpaces();
+                    if(expect(']'))
+                        break;
+                    if(!expect(','))
+                        return false;
+                    output += ",";
+                }
+            }
+
+            output += "]";
+            --_depth;
+            return true;
+        }
+
+        bool object(std::string& output) {
+            if(!expect('{') || ++_depth > REFERENCE_MAX_DEPTH)
+                return false;
+
+            // The last value of a duplicated key wins, the keys are sorted.
+            std::map<std::string, std::string> members;
+
+            whiteSpaces();
+            if(!expect('}')) {
+                while(true) {
+                    whiteSpaces();
+                    std::string key;
+                    if(!string(key))
+                        return false;
+                    whiteSpaces();
+                    if(!expect(':'))
+                        return false;
+
+                    std::string text;
+                    if(!value(text))
+                        return false;
+                    members[key] = text;
+
+                    whiteSpaces();
+                    if(expect('}'))
+                        break;
+                    if(!expect(','))
+                        return false;
+                }
+            }
+
+            output += "{";
+            for(std::map<std::string, std::string>::const_iterator it = members.begin(); it != members.end(); ++it) {
+                if(it != members.begin())
+                    output += ",";
+                output += "\"" + it->first + "\":" + it->second;
+            }
+            output += "}";
+
+            --_depth;
+            return true;
+        }
+
+        const char* _cursor;
+        const char* _end;
+        int _depth;
+};
+
+}
+
+// Parse with the reference parser.
+bool referenceCanonical(const char* data, size_t size, std::string& output) {
+    output.clear();
+    Reference reference(data, size);
+    return reference.document(output);
+}
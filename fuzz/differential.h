@@ -0,0 +1,39 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Differential testing of the Json parser: a strict reference parser and a canonical form of the parsed objects.
+*/
+
+#ifndef DIFFERENTIAL_H
+#define DIFFERENTIAL_H
+
+#include <string>
+
+#include "json/json.h"
+
+/// Canonical text of a parsed object: keys sorted, strings and numbers as written, numbers marked n(...).
+std::string canonical(const Json::Object& object);
+
+/// Strict RFC 8259 parser used as the reference: the input must be one object, surrounded by white spaces only,
+/// nested at most 512 levels. Fills the canonical text of the object, keeping the last value of a duplicated key.
+bool referenceCanonical(const char* data, size_t size, std::string& output);
+
+#endif // DIFFERENTIAL_H
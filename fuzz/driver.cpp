@@ -0,0 +1,178 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Standalone driver of the fuzz targets, for the compilers without libFuzzer: replays the files and
+ * directories given, then runs random mutations of them.
+ *
+ *   json_fuzzer corpus/json                 replay the corpus
+ *   json_fuzzer --runs=100000 corpus/json   replay, then run 100000 mutated inputs
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+/// Largest input generated by mutation.
+static const size_t maxSize = 4096;
+
+/// Tokens inserted by the mutations, the inputs stay close to the grammars.
+static const char* tokens[] = {
+    "{", "}", "[", "]", ":", ",", "\"", "\\", "\\\"", "\\u00e9", " ", "\n", "\r\n", "\r\n\r\n",
+    "null", "true", "false", "0", "-1.5e+3", "\"key\":", "HTTP/1.1 200 OK\r\n", "Content-Length: 4\r\n",
+    "Transfer-Encoding: chunked\r\n", "Content-Encoding: gzip\r\n", "Connection: close\r\n", "0\r\n\r\n", "ffffffff\r\n"
+};
+
+// Add the file, or the files of the directory, to the inputs.
+static void load(const std::string& path, std::vector<std::string>& inputs) {
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0) {
+        fprintf(stderr, "Cannot read %s\n", path.c_str());
+        exit(1);
+    }
+
+    if(S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(path.c_str());
+        while(dirent* entry = readdir(dir))
+            if(entry->d_name[0] != '.')
+                load(path + "/" + entry->d_name, inputs);
+        closedir(dir);
+        return;
+    }
+
+    std::ifstream file(path.c_str(), std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    inputs.push_back(content.str());
+}
+
+// Apply a few random edits to the input.
+static void mutate(std::string& input, std::mt19937& random) {
+    const size_t edits = 1 + random() % 4;
+    for(size_t i = 0; i < edits; ++i) {
+        const size_t position = input.empty() ? 0 : random() % (input.size() + 1);
+        switch(random() % 5) {
+            case 0:
+                if(position < input.size())
+                    input[position] = static_cast<char>(random());
+                break;
+            case 1:
+                input.insert(position, tokens[random() % (sizeof(tokens) / sizeof(tokens[0]))]);
+                break;
+            case 2:
+                input.erase(position, random() % 16);
+                break;
+            case 3: {
+                const size_t length = random() % 32;
+                if(position < input.size())
+                    input.insert(random() % (input.size() + 1), input.substr(position, length));
+                break;
+            }
+            default:
+                input.resize(position);
+                break;
+        }
+    }
+
+    if(input.size() > maxSize)
+        input.resize(maxSize);
+}
+
+/// Input being run, saved if the target crashes.
+static const std::string* current = 0;
+
+// Save the crashing input to crash-input, as libFuzzer does, then let the signal kill the process.
+static void crashed(int signal) {
+    if(current) {
+        int fd = open("crash-input", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd >= 0) {
+            if(write(fd, current->data(), current->size()) >= 0)
+                write(STDERR_FILENO, "Input saved to crash-input\n", 27);
+            close(fd);
+        }
+    }
+
+    std::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+// Run the target on the input.
+static void run(const std::string& input) {
+    current = &input;
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+    current = 0;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long runs = 0;
+    unsigned long seed = std::random_device()();
+    std::vector<std::string> inputs;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strncmp(argv[i], "--runs=", 7) == 0)
+            runs = strtoul(argv[i] + 7, 0, 10);
+        else if(strncmp(argv[i], "--seed=", 7) == 0)
+            seed = strtoul(argv[i] + 7, 0, 10);
+        else
+            load(argv[i], inputs);
+    }
+
+    std::signal(SIGABRT, crashed);
+    std::signal(SIGSEGV, crashed);
+
+    for(const std::string& input : inputs)
+        run(input);
+
+    printf("Replayed %zu inputs.\n", inputs.size());
+
+    if(runs == 0)
+        return 0;
+
+    if(inputs.empty())
+        inputs.push_back("{}");
+
+    // The seed reproduces a failing run.
+    printf("Running %lu mutations, --seed=%lu\n", runs, seed);
+    fflush(stdout);
+
+    std::mt19937 random(seed);
+    for(unsigned long i = 0; i < runs; ++i) {
+        std::string input = inputs[random() % inputs.size()];
+        mutate(input, random);
+        run(input);
+    }
+
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Fuzz target of the HTTP response reader: the response is read identically whatever the sizes of
+ * the reads on the socket.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "http/response.h"
+
+/// Outcome of one reading of the response.
+struct Reading {
+    Result result;
+    unsigned int status;
+    std::string output;
+};
+
+// Feed the response in segments of the given size, then close the connection if the response is incomplete.
+static Reading read(const std::vector<char>& input, size_t segment) {
+    Reading reading;
+    ResponseReader reader(reading.output, false);
+
+    reading.result = MORE_DATA;
+    for(size_t offset = 0; offset < input.size() && reading.result == MORE_DATA; offset += segment) {
+        // Exact size copy of the segment, any read past the end is caught by the address sanitizer.
+        std::vector<char> bytes(input.begin() + offset, input.begin() + std::min(input.size(), offset + segment));
+        reading.result = reader.feed(bytes.data(), bytes.size());
+    }
+
+    if(reading.result == MORE_DATA)
+        reading.result = reader.finish();
+
+    reading.status = reader.statusCode();
+    return reading;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::vector<char> input(data, data + size);
+
+    const Reading whole = read(input, size ? size : 1);
+
+    // One byte at a time, and segments of a size picked by the input.
+    const size_t segments[] = {1, size ? static_cast<size_t>(2 + data[0] % 61) : 2};
+
+    for(size_t segment : segments) {
+        const Reading split = read(input, segment);
+
+        // The body of a failed response is never used, only its failure must be found.
+        const bool sameOutput = whole.result == ERROR || split.output == whole.output;
+
+        if(split.result != whole.result || split.status != whole.status || !sameOutput) {
+            fprintf(stderr, "Response read differently in segments of %zu bytes: result %d/%d, status %u/%u, body %zu/%zu bytes.\n",
+                    segment, whole.result, split.result, whole.status, split.status, whole.output.size(), split.output.size());
+            abort();
+        }
+    }
+
+    return 0;
+}
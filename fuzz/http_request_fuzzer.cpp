@@ -0,0 +1,137 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Fuzz target of HTTP::request on a loopback connection: a server thread answers the request with the
+ * input then closes. A response the reader cannot complete must fail with no status code, a complete
+ * one must be returned with its status, and its body as read unless the client drops it for an error status.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "http/http.h"
+#include "http/response.h"
+
+// Listening socket on a free port of the loopback, opened once.
+static int listener(unsigned short& port) {
+    static int fd = -1;
+    static unsigned short listenPort = 0;
+
+    if(fd < 0) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        socklen_t length = sizeof(address);
+        if(fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(fd, 16) != 0
+           || getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            perror("Cannot listen on the loopback");
+            abort();
+        }
+
+        listenPort = ntohs(address.sin_port);
+        Logger::setLevel(LogLevel::OFF);
+    }
+
+    port = listenPort;
+    return fd;
+}
+
+// Accept one connection, read the request headers, answer with the response and close.
+static void serve(int fd, const std::vector<char>& response) {
+    int connection = accept(fd, 0, 0);
+    if(connection < 0)
+        return;
+
+    std::string request;
+    char buffer[4096];
+    while(request.find("\r\n\r\n") == std::string::npos) {
+        ssize_t size = read(connection, buffer, sizeof(buffer));
+        if(size <= 0)
+            break;
+        request.append(buffer, size);
+    }
+
+    size_t written = 0;
+    while(written < response.size()) {
+        ssize_t size = write(connection, response.data() + written, response.size() - written);
+        if(size <= 0)
+            break;
+        written += size;
+    }
+
+    close(connection);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::vector<char> input(data, data + size);
+
+    // What the reader makes of the whole response, the server closing the connection after it.
+    std::string expected;
+    ResponseReader reader(expected, false);
+    Result expectedResult = reader.feed(input.data(), input.size());
+    if(expectedResult == MORE_DATA)
+        expectedResult = reader.finish();
+
+    unsigned short port;
+    int fd = listener(port);
+    std::thread server(serve, fd, std::cref(input));
+
+    HTTP http("127.0.0.1:" + std::to_string(port), false);
+    Timeouts timeouts;
+    timeouts.read = std::chrono::milliseconds(1000);
+    http.setTimeouts(timeouts);
+
+    std::string output;
+    Result result = ERROR;
+    unsigned int statusCode = 0;
+    try {
+        statusCode = http.request("GET", "_search", 0, output, result);
+    }
+    catch(const Exception&) {
+        result = ERROR;
+    }
+
+    server.join();
+
+    bool same = (expectedResult == OK) ? (result == OK && statusCode == reader.statusCode() && (output.empty() || output == expected))
+                                       : (result == ERROR && statusCode == 0 && output.empty());
+    if(!same) {
+        fprintf(stderr, "Request read differently: expected result %d status %u body %zu bytes, got result %d status %u body %zu bytes.\n",
+                expectedResult, reader.statusCode(), expected.size(), result, statusCode, output.size());
+        abort();
+    }
+
+    return 0;
+}
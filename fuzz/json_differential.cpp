@@ -0,0 +1,83 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Differential fuzz target of the Json parser against the strict reference parser: every document
+ * accepted by the reference is accepted by the parser with the same content, and survives the round
+ * trip through str().
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "differential.h"
+
+// Report the mismatch and abort, so that the fuzzer saves the input.
+static void mismatch(const char* what, const std::string& expected, const std::string& actual) {
+    fprintf(stderr, "%s\n  expected: %s\n  actual:   %s\n", what, expected.c_str(), actual.c_str());
+    abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::vector<char> input(data, data + size);
+    const char* start = input.data();
+    const char* end = start + size;
+
+    // The parser is more lenient than the reference, only the documents of the reference are compared.
+    std::string expected;
+    if(!referenceCanonical(start, size, expected))
+        return 0;
+
+    while(start < end && isspace(*start))
+        ++start;
+
+    Json::Object object;
+    const char* stop = 0;
+    try {
+        stop = object.addMember(start, end);
+    }
+    catch(const std::logic_error& e) {
+        mismatch("Valid document rejected.", expected, e.what());
+    }
+
+    while(stop < end && isspace(*stop))
+        ++stop;
+
+    if(stop != end)
+        mismatch("Document not consumed.", expected, std::string(stop, end - stop));
+
+    std::string actual = canonical(object);
+    if(actual != expected)
+        mismatch("Document parsed differently.", expected, actual);
+
+    // Serialized document is read back identically.
+    const std::string serialized = object.str();
+    std::string roundTrip;
+    if(!referenceCanonical(serialized.c_str(), serialized.size(), roundTrip))
+        mismatch("Serialized document is invalid.", expected, serialized);
+
+    if(roundTrip != expected)
+        mismatch("Serialized document differs.", expected, roundTrip);
+
+    return 0;
+}
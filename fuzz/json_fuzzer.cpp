@@ -0,0 +1,51 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Fuzz target of the Json parser: any input is either parsed or rejected with std::logic_error,
+ * never crashes, reads out of bounds nor overflows the stack.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "json/json.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // Exact size copy, any read past the end is caught by the address sanitizer.
+    std::vector<char> input(data, data + size);
+    const char* start = input.data();
+    const char* end = start + size;
+
+    while(start < end && isspace(*start))
+        ++start;
+
+    try {
+        Json::Object object;
+        object.addMember(start, end);
+        object.str();
+    }
+    catch(const std::logic_error&) {
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "batcher.h"
+#include "elasticsearch.h"
+#include "http/context.h"
+
+#include <algorithm>
+
+/// Longest wait between two checks of the cancellation of a waiting lookup.
+#define BATCHER_POLL_MILLISECONDS 10
+
+MultiGetBatcher::MultiGetBatcher(ElasticSearch& es, std::chrono::microseconds window, size_t maxBatchSize)
+: _es(es), _window(window), _maxBatchSize(maxBatchSize > 0 ? maxBatchSize : 1), _active(0) {
+}
+
+MultiGetBatcher::~MultiGetBatcher() {
+}
+
+// Request the document by index/type/id within the current batch.
+bool MultiGetBatcher::get(const std::string& index, const std::string& type, const std::string& id, Json::Object& msg, bool& found, bool source) {
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Count the caller while in get, the lock is held at every exit.
+    struct Active {
+        Active(size_t& active) : count(active) { ++count; }
+        ~Active() { --count; }
+        size_t& count;
+    } active(_active);
+
+    // The first lookup of a window opens the batch and leads it.
+    bool leader = !_open;
+    if(leader)
+        _open = std::make_shared<Batch>();
+
+    std::shared_ptr<Batch> batch = _open;
+    size_t slot = batch->ids.size();
+
+    DocumentId documentId;
+    documentId.index = index;
+    documentId.type = type;
+    documentId.id = id;
+
+    batch->ids.push_back(documentId);
+    batch->sources.push_back(source);
+
+    // Close a full batch so the next lookup opens a new one.
+    if(batch->ids.size() >= _maxBatchSize) {
+        batch->closed = true;
+        _open.reset();
+        _full.notify_all();
+    }
+
+    const RequestContext& context = RequestContext::current();
+
+    // A lone caller sends at once, waiting only pays when other lookups are in flight to join it.
+    if(leader && _active > 1) {
+        // Wait for the other lookups until the end of the window or a full batch, within the deadline.
+        std::chrono::microseconds window = _window;
+        if(context.hasDeadline())
+            window = std::min(window, std::chrono::duration_cast<std::chrono::microseconds>(context.deadline() - RequestContext::Clock::now()));
+
+        if(window.count() > 0)
+            _full.wait_for(lock, window, [&batch]{ return batch->closed; });
+    }
+
+    if(leader && !batch->closed) {
+        batch->closed = true;
+        _open.reset();
+    }
+
+    while(!batch->done) {
+
+        // The leader sends the batch, or a waiting caller if the leader stopped before.
+        if(batch->closed && !batch->flushing && !context.aborted()) {
+            batch->flushing = true;
+
+            lock.unlock();
+            flush(*batch);
+            lock.lock();
+
+            batch->done = true;
+            _done.notify_all();
+            break;
+        }
+
+        // Leave the batch, its documents are not written to the caller anymore. A leader that did
+        // not send the batch wakes the others so one sends it.
+        if(context.aborted() && batch->closed && !batch->flushing)
+            _done.notify_all();
+
+        if(context.cancelled())
+            EXCEPTION("Request cancelled.");
+
+        if(context.expired())
+            EXCEPTION("Request deadline exceeded.");
+
+        // The token has no condition to wait on, it is checked every few milliseconds.
+        _done.wait_for(lock, context.remaining(std::chrono::milliseconds(BATCHER_POLL_MILLISECONDS)));
+    }
+
+    if(batch->failed)
+        return false;
+
+    msg.clear();
+    msg.append(batch->docs[slot]);
+    found = batch->found[slot];
+    return true;
+}
+
+// Send the batch and dispatch the documents to the callers.
+void MultiGetBatcher::flush(Batch& batch) {
+
+    batch.docs.resize(batch.ids.size());
+    batch.found.assign(batch.ids.size(), false);
+
+    try {
+        Json::Array docs;
+        if(!_es.mget(batch.ids, batch.sources, docs) || docs.size() != batch.ids.size()) {
+            ES_LOG(WARNING, "Multi get of " << batch.ids.size() << " documents failed, each one is requested on its own.");
+            batch.failed = true;
+            return;
+        }
+
+        size_t slot = 0;
+        for(const Json::Value& value : docs) {
+            Json::Object& msg = batch.docs[slot];
+            msg.append(value.getObject());
+
+            // Same shape as a single get response.
+            bool found = msg.member("found") && msg.getValue("found");
+            msg.addMemberByKey("status", found ? 200 : 404);
+            batch.found[slot] = found;
+            ++slot;
+        }
+    }
+    catch(Exception& e) {
+        ES_LOG(WARNING, "Multi get of " << batch.ids.size() << " documents failed, each one is requested on its own: " << e.what());
+        batch.failed = true;
+    }
+    catch(std::exception& e) {
+        ES_LOG(WARNING, "Multi get of " << batch.ids.size() << " documents failed, each one is requested on its own: " << e.what());
+        batch.failed = true;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef BATCHER_H
+#define BATCHER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "json/json.h"
+
+class ElasticSearch;
+struct DocumentId;
+
+/// Combines the single document lookups of many threads into one _mget.
+/// The first caller of a window becomes the leader: it waits for the window (or a full batch),
+/// sends the _mget and hands each document back to the waiting callers, in order.
+/// A leader alone in the batcher sends at once, the window is only waited under load.
+/// A caller stops waiting at its deadline or cancellation. If the leader stops before the flush,
+/// a caller still waiting sends the batch in its place.
+class MultiGetBatcher {
+    public:
+        MultiGetBatcher(ElasticSearch& es, std::chrono::microseconds window, size_t maxBatchSize);
+        ~MultiGetBatcher();
+
+        /// Request the document by index/type/id within the current batch, found is the "found" field.
+        /// Without source, only the metadata of the document is requested, as for exist.
+        /// Returns false if the _mget failed, the caller then sends its own request as without batching.
+        bool get(const std::string& index, const std::string& type, const std::string& id, Json::Object& msg, bool& found, bool source = true);
+
+    private:
+        /// Lookups gathered during one window.
+        struct Batch {
+            std::vector<DocumentId> ids;
+
+            /// Source requested or not, by slot.
+            std::vector<bool> sources;
+
+            /// Documents by slot, each caller copies its own so none is written after its caller left.
+            std::vector<Json::Object> docs;
+            std::vector<bool> found;
+
+            /// No more lookups are added.
+            bool closed;
+
+            /// A caller is sending the _mget.
+            bool flushing;
+
+            bool done;
+
+            /// The _mget failed, each caller sends its own request.
+            bool failed;
+
+            Batch(): closed(false), flushing(false), done(false), failed(false) {}
+        };
+
+        /// Send the batch and dispatch the documents to the callers.
+        void flush(Batch& batch);
+
+        /// Client used to send the _mget.
+        ElasticSearch& _es;
+
+        /// Time the leader waits for other lookups.
+        std::chrono::microseconds _window;
+
+        /// A full batch is sent without waiting the end of the window.
+        size_t _maxBatchSize;
+
+        /// Batch currently gathering lookups, null if none.
+        std::shared_ptr<Batch> _open;
+
+        /// Callers in get, waiting or sending.
+        size_t _active;
+
+        std::mutex _mutex;
+        std::condition_variable _full;
+        std::condition_variable _done;
+};
+
+#endif // BATCHER_H
@@ -0,0 +1,192 @@
+#include "cache.h"
+
+#include <functional>
+
+// Key of the document.
+static std::string documentKey(const std::string& index, const std::string& type, const std::string& id) {
+    std::string key;
+    key.reserve(index.size() + type.size() + id.size() + 2);
+    key += index;
+    key += '/';
+    key += type;
+    key += '/';
+    key += id;
+    return key;
+}
+
+DocumentCache::DocumentCache(size_t capacity, std::chrono::milliseconds ttl, size_t shardCount)
+: _ttl(ttl), _generation(0) {
+    if(shardCount == 0)
+        shardCount = 1;
+
+    _shardCapacity = (capacity + shardCount - 1) / shardCount;
+    if(_shardCapacity == 0)
+        _shardCapacity = 1;
+
+    for(size_t i = 0; i < shardCount; ++i)
+        _shards.push_back(std::unique_ptr<Shard>(new Shard));
+}
+
+DocumentCache::~DocumentCache() {
+}
+
+// Shard of the key.
+DocumentCache::Shard& DocumentCache::shard(const std::string& key) {
+    return *_shards[std::hash<std::string>()(key) % _shards.size()];
+}
+
+// Fill msg as a get response if the document is cached and fresh.
+bool DocumentCache::get(const std::string& index, const std::string& type, const std::string& id, Json::Object& msg) {
+    std::string key = documentKey(index, type, id);
+    Shard& s = shard(key);
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto it = s.entries.find(key);
+    if(it == s.entries.end())
+        return false;
+
+    Entry& entry = *it->second;
+    if(entry.tombstone)
+        return false;
+
+    if(entry.expire <= Clock::now()) {
+        remove(s, key);
+        return false;
+    }
+
+    // Most recently used first.
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+
+    msg.clear();
+    msg.addMemberByKey("_index", index);
+    msg.addMemberByKey("_type", type);
+    msg.addMemberByKey("_id", id);
+    msg.addMemberByKey("_version", entry.version);
+    if(entry.seqNo >= 0)
+        msg.addMemberByKey("_seq_no", entry.seqNo);
+    msg.addMemberByKey("found", true);
+    msg.addMemberByKey("_source", entry.source);
+    msg.addMemberByKey("status", 200);
+
+    return true;
+}
+
+// Store the get response of a found document.
+void DocumentCache::put(const std::string& index, const std::string& type, const std::string& id, const Json::Object& msg, Clock::time_point requested, uint64_t generation) {
+    if(!msg.member("found") || !msg.getValue("found") || !msg.member("_source"))
+        return;
+
+    long version = msg.member("_version") ? msg.getValue("_version").getLong() : 0;
+
+    std::string key = documentKey(index, type, id);
+    Shard& s = shard(key);
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    // Sent before a clear(), the get may predate a bulk write.
+    if(generation != _generation.load(std::memory_order_acquire))
+        return;
+
+    Clock::time_point now = Clock::now();
+    auto it = s.entries.find(key);
+    if(it != s.entries.end()) {
+        const Entry& previous = *it->second;
+
+        if(previous.expire > now) {
+            // Never replace a newer version.
+            if(previous.version > 0 && version > 0 && version < previous.version)
+                return;
+
+            // Without versions, a get sent before the write may be stale.
+            if(previous.tombstone && (previous.version == 0 || version == 0) && requested < previous.created)
+                return;
+        }
+
+        remove(s, key);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.source.append(msg.getValue("_source").getObject());
+    entry.version = version;
+    entry.seqNo = msg.member("_seq_no") ? msg.getValue("_seq_no").getLong() : -1;
+    entry.tombstone = false;
+    entry.created = now;
+    entry.expire = now + _ttl;
+
+    insert(s, entry);
+}
+
+// Invalidate the document after a write.
+void DocumentCache::invalidate(const std::string& index, const std::string& type, const std::string& id, long version) {
+    std::string key = documentKey(index, type, id);
+    Shard& s = shard(key);
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    remove(s, key);
+
+    Entry entry;
+    entry.key = key;
+    entry.version = version;
+    entry.seqNo = -1;
+    entry.tombstone = true;
+    entry.created = Clock::now();
+    entry.expire = entry.created + _ttl;
+
+    purge(s, entry.created);
+
+    // The TTL is the same for all, the newest tombstone expires last.
+    s.tombstones.push_back(entry);
+    s.entries[key] = --s.tombstones.end();
+}
+
+// Move the entry to the front, evicting the least recently used ones.
+void DocumentCache::insert(Shard& s, const Entry& entry) {
+    purge(s, entry.created);
+
+    // Only the documents are evicted, a tombstone must outlive the gets it guards against.
+    while(!s.lru.empty() && s.lru.size() >= _shardCapacity) {
+        s.entries.erase(s.lru.back().key);
+        s.lru.pop_back();
+    }
+
+    s.lru.push_front(entry);
+    s.entries[entry.key] = s.lru.begin();
+}
+
+// Remove the entry of the key if any.
+void DocumentCache::remove(Shard& s, const std::string& key) {
+    auto it = s.entries.find(key);
+    if(it == s.entries.end())
+        return;
+
+    if(it->second->tombstone)
+        s.tombstones.erase(it->second);
+    else
+        s.lru.erase(it->second);
+
+    s.entries.erase(it);
+}
+
+// Remove the expired tombstones.
+void DocumentCache::purge(Shard& s, Clock::time_point now) {
+    while(!s.tombstones.empty() && s.tombstones.front().expire <= now) {
+        s.entries.erase(s.tombstones.front().key);
+        s.tombstones.pop_front();
+    }
+}
+
+// Invalidate all documents.
+void DocumentCache::clear() {
+    // First, so a get answered during the clear is not stored back.
+    _generation.fetch_add(1, std::memory_order_acq_rel);
+
+    for(std::unique_ptr<Shard>& s : _shards) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->lru.clear();
+        s->tombstones.clear();
+        s->entries.clear();
+    }
+}
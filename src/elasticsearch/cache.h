@@ -0,0 +1,91 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+#include "json/json.h"
+
+/// Sharded LRU cache of the documents fetched by index/type/id.
+/// Entries keep the parsed _source with its _version and _seq_no and expire after the TTL.
+/// A write invalidates the entry with a tombstone holding the written version, so a get sent
+/// before the write and answered after it cannot bring the stale document back. Tombstones are never
+/// evicted before they expire, and clear() starts a new generation so the gets sent before it are dropped.
+class DocumentCache {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        DocumentCache(size_t capacity, std::chrono::milliseconds ttl, size_t shardCount = 16);
+        ~DocumentCache();
+
+        /// Fill msg as a get response if the document is cached and fresh.
+        bool get(const std::string& index, const std::string& type, const std::string& id, Json::Object& msg);
+
+        /// Store the get response of a found document, requested at the given time and generation.
+        void put(const std::string& index, const std::string& type, const std::string& id, const Json::Object& msg, Clock::time_point requested, uint64_t generation);
+
+        /// Generation to capture with the time of a get, bumped by clear().
+        inline uint64_t generation() const { return _generation.load(std::memory_order_acquire); }
+
+        /// Invalidate the document after a write, version is the written one or 0 if unknown.
+        void invalidate(const std::string& index, const std::string& type, const std::string& id, long version = 0);
+
+        /// Invalidate all documents, the gets of the previous generations are not stored anymore.
+        void clear();
+
+    private:
+        struct Entry {
+            std::string key;
+            Json::Object source;
+            long version;
+            long seqNo;
+            bool tombstone;
+            Clock::time_point created;
+            Clock::time_point expire;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+
+            /// Documents, most recently used first.
+            std::list<Entry> lru;
+
+            /// Tombstones by creation, so by expiry. Out of the LRU, they are kept until they expire.
+            std::list<Entry> tombstones;
+
+            std::unordered_map< std::string, std::list<Entry>::iterator > entries;
+        };
+
+        /// Shard of the key.
+        Shard& shard(const std::string& key);
+
+        /// Move the entry to the front, evicting the least recently used ones.
+        void insert(Shard& shard, const Entry& entry);
+
+        /// Remove the entry of the key if any.
+        void remove(Shard& shard, const std::string& key);
+
+        /// Remove the expired tombstones.
+        void purge(Shard& shard, Clock::time_point now);
+
+        /// Cached documents by shard.
+        std::vector< std::unique_ptr<Shard> > _shards;
+
+        /// Maximum number of entries of each shard.
+        size_t _shardCapacity;
+
+        /// Time to live of an entry.
+        std::chrono::milliseconds _ttl;
+
+        /// Bumped by clear().
+        std::atomic<uint64_t> _generation;
+};
+
+#endif // CACHE_H
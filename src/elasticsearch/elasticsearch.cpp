@@ -1,4 +1,8 @@
 #include "elasticsearch.h"
+#include "batcher.h"
+#include "cache.h"
+#include "routing.h"
+#include "slowlog.h"
 
 #include <iostream>
 #include <sstream>
@@ -7,14 +11,61 @@
 #include <locale>
 #include <vector>
 
-ElasticSearch::ElasticSearch(const std::string& node, bool readOnly): _http(node, true), _readOnly(readOnly) {
+/// Time an operation and record it in the slow query log if it is slow or failed, nothing without log.
+/// The operation failed unless succeeded is called, as when an exception is thrown.
+class SlowQueryTimer {
+    public:
+        SlowQueryTimer(SlowQueryLog* log, const char* method, const std::string& endUrl, const char* body)
+        : _log(log), _method(method), _endUrl(endUrl), _body(body), _statusCode(0), _failed(true), _sequence(0) {
+            if(!_log)
+                return;
+
+            _start = SlowQueryLog::Clock::now();
+            _sequence = Instrumentation::lastRequest().sequence;
+        }
+
+        ~SlowQueryTimer() {
+            if(!_log)
+                return;
+
+            SlowQueryLog::Clock::duration duration = SlowQueryLog::Clock::now() - _start;
+            if(_failed || _log->slow(duration))
+                _log->record(_method, _endUrl, _body, _statusCode, _failed, duration, _sequence);
+        }
+
+        /// Status code of the response.
+        inline void status(unsigned int statusCode) { _statusCode = statusCode; }
+
+        /// The operation succeeded.
+        inline void succeeded() { _failed = false; }
+
+    private:
+        SlowQueryLog* _log;
+        const char* _method;
+        const std::string& _endUrl;
+        const char* _body;
+        unsigned int _statusCode;
+        bool _failed;
+        uint64_t _sequence;
+        SlowQueryLog::Clock::time_point _start;
+};
+
+ElasticSearch::ElasticSearch(const std::string& node, bool readOnly): _pool(std::vector<std::string>(1, node)), _readOnly(readOnly), _sniffing(false) {
 
     // Test if instance is active.
     if(!isActive())
         EXCEPTION("Cannot create engine, database is not active.");
 }
 
+ElasticSearch::ElasticSearch(const std::vector<std::string>& nodes, bool readOnly, ConnectionPool::Selection selection): _pool(nodes, selection), _readOnly(readOnly), _sniffing(false) {
+
+    // Test if at least one instance is active.
+    if(!isActive())
+        EXCEPTION("Cannot create engine, database is not active.");
+}
+
 ElasticSearch::~ElasticSearch() {
+    stopSniffing();
 }
 
 // Test connection with node.
@@ -23,18 +74,18 @@ bool ElasticSearch::isActive() {
     Json::Object root;
 
     try {
-        _http.get(0, 0, &root);
+        _pool.get(0, 0, &root);
     }
     catch(Exception& e){
-        printf("get(0) failed in ElasticSearch::isActive(). Exception caught: %s\n", e.what());
+        ES_LOG(WARNING, "get(0) failed in ElasticSearch::isActive(). Exception caught: " << e.what());
         return false;
     }
     catch(std::exception& e){
-        printf("get(0) failed in ElasticSearch::isActive(). std::exception caught: %s\n", e.what());
+        ES_LOG(WARNING, "get(0) failed in ElasticSearch::isActive(). std::exception caught: " << e.what());
         return false;
     }
     catch(...){
-        printf("get(0) failed in ElasticSearch::isActive().\n");
+        ES_LOG(WARNING, "get(0) failed in ElasticSearch::isActive().");
         return false;
     }
 
@@ -42,28 +93,363 @@ bool ElasticSearch::isActive() {
         return false;
 
     if(!root.member("status") || root["status"].getInt() != 200){
-        printf("Status is not 200. Cannot find Elasticsearch Node.\n");
+        ES_LOG(WARNING, "Status is not 200. Cannot find Elasticsearch Node.");
         return false;
     }
 
     return true;
 }
 
+// Join field names for filter_path and _source parameters.
+static std::string joinFields(const std::vector<std::string>& fields) {
+    std::string joined;
+    for(const std::string& field : fields) {
+        if(!joined.empty())
+            joined += ',';
+        joined += field;
+    }
+    return joined;
+}
+
+// Discover the nodes of the cluster.
+bool ElasticSearch::sniff() {
+
+    Json::Object msg;
+    if(200 != _pool.get("_nodes/http?filter_path=nodes.*.http.publish_address,nodes.*.roles", 0, &msg) || !msg.member("nodes"))
+        return false;
+
+    std::vector<std::string> nodes;
+    for(Json::Object::const_iterator it = msg["nodes"].getObject().begin(); it != msg["nodes"].getObject().end(); ++it) {
+        const Json::Object& node = it.value().getObject();
+
+        if(!node.member("http") || !node["http"].getObject().member("publish_address"))
+            continue;
+
+        // Dedicated master nodes must not coordinate requests.
+        if(node.member("roles") && node["roles"].getArray().size() == 1 && node["roles"].getArray().first().getString() == "master")
+            continue;
+
+        // The address is published as ip:port or hostname/ip:port.
+        std::string address = node["http"].getObject()["publish_address"].getString();
+        size_t pos = address.find('/');
+        if(pos != std::string::npos)
+            address = address.substr(pos + 1);
+
+        nodes.push_back(address);
+    }
+
+    if(nodes.empty())
+        return false;
+
+    _pool.setNodes(nodes);
+    return true;
+}
+
+// Sniff the nodes in background at every interval.
+void ElasticSearch::startSniffing(std::chrono::seconds interval) {
+    stopSniffing();
+
+    _sniffing = true;
+    _sniffer = std::thread([this, interval]{
+        std::unique_lock<std::mutex> lock(_snifferMutex);
+        while(_sniffing) {
+            lock.unlock();
+            try {
+                sniff();
+            }
+            catch(...) {
+                // Keep the current nodes, the next sniff may succeed.
+            }
+            lock.lock();
+
+            _snifferWakeup.wait_for(lock, interval, [this]{ return !_sniffing; });
+        }
+    });
+}
+
+// Stop the background sniffing.
+void ElasticSearch::stopSniffing() {
+    {
+        std::lock_guard<std::mutex> lock(_snifferMutex);
+        _sniffing = false;
+    }
+    _snifferWakeup.notify_all();
+
+    if(_sniffer.joinable())
+        _sniffer.join();
+}
+
 // Request the document by index/type/id.
-bool ElasticSearch::getDocument(const char* index, const char* type, const char* id, Json::Object& msg){
+bool ElasticSearch::getDocument(const char* index, const char* type, const char* id, Json::Object& msg, const std::vector<std::string>& sourceIncludes, const std::vector<std::string>& sourceExcludes){
+    bool wholeSource = sourceIncludes.empty() && sourceExcludes.empty();
+
+    if(_cache && wholeSource) {
+        if(_cache->get(index, type, id, msg))
+            return true;
+
+        DocumentCache::Clock::time_point requested = DocumentCache::Clock::now();
+        uint64_t generation = _cache->generation();
+        bool found = fetchDocument(index, type, id, msg, sourceIncludes, sourceExcludes);
+        if(found)
+            _cache->put(index, type, id, msg, requested, generation);
+
+        return found;
+    }
+
+    return fetchDocument(index, type, id, msg, sourceIncludes, sourceExcludes);
+}
+
+// Request the document within a batch for the whole source, on its own otherwise or if the batch failed.
+bool ElasticSearch::fetchDocument(const char* index, const char* type, const char* id, Json::Object& msg, const std::vector<std::string>& sourceIncludes, const std::vector<std::string>& sourceExcludes){
+    bool found = false;
+    if(_batcher && sourceIncludes.empty() && sourceExcludes.empty() && _batcher->get(index, type, id, msg, found))
+        return found;
+
+    return getDocumentById(index, type, id, msg, sourceIncludes, sourceExcludes);
+}
+
+// Send the get request of the document by index/type/id.
+bool ElasticSearch::getDocumentById(const char* index, const char* type, const char* id, Json::Object& msg, const std::vector<std::string>& sourceIncludes, const std::vector<std::string>& sourceExcludes){
     std::ostringstream oss;
     oss << index << "/" << type << "/" << id;
-    _http.get(oss.str().c_str(), 0, &msg);
+
+    char separator = '?';
+    if(!sourceIncludes.empty()) {
+        oss << separator << "_source_includes=" << joinFields(sourceIncludes);
+        separator = '&';
+    }
+    if(!sourceExcludes.empty())
+        oss << separator << "_source_excludes=" << joinFields(sourceExcludes);
+
+    documentRequest("GET", index, id, false, oss.str().c_str(), 0, &msg);
     return msg["found"];
 }
 
+// Request the documents by index/type/ids with a single _mget.
+bool ElasticSearch::mget(const std::string& index, const std::string& type, const std::vector<std::string>& ids, Json::Array& docs){
+    std::ostringstream oss;
+    oss << index << "/" << type << "/_mget";
+
+    std::ostringstream data;
+    data << "{\"ids\":[";
+    for(size_t i = 0; i < ids.size(); ++i) {
+        if(i > 0)
+            data << ",";
+        data << "\"" << Json::Value::escapeJsonString(ids[i]) << "\"";
+    }
+    data << "]}";
+
+    Json::Object msg;
+    if(200 != _pool.post(oss.str().c_str(), data.str().c_str(), &msg) || !msg.member("docs"))
+        return false;
+
+    for(const Json::Value& value : msg["docs"].getArray())
+        docs.addElement(value);
+
+    return true;
+}
+
+// Request the documents by index/type/id with a single _mget.
+bool ElasticSearch::mget(const std::vector<DocumentId>& ids, Json::Array& docs){
+    return mget(ids, std::vector<bool>(), docs);
+}
+
+// Request the documents by index/type/id with a single _mget, the source of each only if requested.
+bool ElasticSearch::mget(const std::vector<DocumentId>& ids, const std::vector<bool>& sources, Json::Array& docs){
+    std::ostringstream data;
+    data << "{\"docs\":[";
+    for(size_t i = 0; i < ids.size(); ++i) {
+        if(i > 0)
+            data << ",";
+        data << "{\"_index\":\"" << Json::Value::escapeJsonString(ids[i].index) << "\"";
+        data << ",\"_type\":\"" << Json::Value::escapeJsonString(ids[i].type) << "\"";
+        data << ",\"_id\":\"" << Json::Value::escapeJsonString(ids[i].id) << "\"";
+        if(i < sources.size() && !sources[i])
+            data << ",\"_source\":false";
+        data << "}";
+    }
+    data << "]}";
+
+    Json::Object msg;
+    if(200 != _pool.post("_mget", data.str().c_str(), &msg) || !msg.member("docs"))
+        return false;
+
+    for(const Json::Value& value : msg["docs"].getArray())
+        docs.addElement(value);
+
+    return true;
+}
+
+// Combine concurrent getDocument/exist by id into _mget requests.
+void ElasticSearch::setAutoBatching(std::chrono::microseconds window, size_t maxBatchSize){
+    if(window.count() <= 0) {
+        _batcher.reset();
+        return;
+    }
+
+    _batcher.reset(new MultiGetBatcher(*this, window, maxBatchSize));
+}
+
+// Cache the documents fetched by id.
+void ElasticSearch::setDocumentCache(size_t capacity, std::chrono::milliseconds ttl, size_t shardCount){
+    if(capacity == 0 || ttl.count() <= 0) {
+        _cache.reset();
+        return;
+    }
+
+    _cache.reset(new DocumentCache(capacity, ttl, shardCount));
+}
+
+// Keep the slow operations in a fixed ring.
+void ElasticSearch::setSlowQueryLog(std::chrono::milliseconds threshold, size_t capacity){
+    if(capacity == 0) {
+        _slowLog.reset();
+        return;
+    }
+
+    _slowLog.reset(new SlowQueryLog(capacity, threshold));
+}
+
+// The slow operations recorded so far as text.
+std::string ElasticSearch::dumpSlowQueries() const {
+    return _slowLog ? _slowLog->str() : std::string();
+}
+
+// Invalidate the cached document after a write.
+void ElasticSearch::invalidateDocument(const std::string& index, const std::string& type, const std::string& id, const Json::Object& result){
+    if(!_cache)
+        return;
+
+    long version = 0;
+    if(result.member("_version") && !result.getValue("_version").isNull())
+        version = result.getValue("_version").getLong();
+
+    _cache->invalidate(index, type, id, version);
+}
+
+// Invalidate all the cached documents after a write by index, type or bulk.
+void ElasticSearch::invalidateDocuments(){
+    if(_cache)
+        _cache->clear();
+}
+
+// Route the point operations to a node holding the shard of the document.
+void ElasticSearch::setShardRouting(std::chrono::seconds refresh){
+    if(refresh.count() <= 0) {
+        _router.reset();
+        return;
+    }
+
+    _router.reset(new ShardRouter(_pool, refresh));
+}
+
+// Compress the request bodies from threshold bytes and accept compressed responses.
+void ElasticSearch::setCompression(size_t threshold, bool acceptEncoding){
+    _pool.setCompression(threshold, acceptEncoding);
+}
+
+// Default timeouts of the requests.
+void ElasticSearch::setTimeouts(const Timeouts& timeouts){
+    _pool.setTimeouts(timeouts);
+}
+
+// Tuning of the sockets of the connections.
+void ElasticSearch::setSocketOptions(const SocketOptions& options){
+    _pool.setSocketOptions(options);
+}
+
+// Follow every request sent to the cluster.
+void ElasticSearch::setTraceHook(const std::shared_ptr<TraceHook>& hook){
+    _pool.setTraceHook(hook);
+}
+
+// Hedge the searches and the reads by id after the latency at percentile of the recent ones.
+void ElasticSearch::setHedging(double percentile, std::chrono::milliseconds initialDelay){
+    _pool.setHedging(percentile, initialDelay);
+}
+
+// Stop sending requests to a node for a while when too many of its requests fail or are slow.
+void ElasticSearch::setCircuitBreaker(bool enabled, const CircuitBreaker::Settings& settings){
+    _pool.setCircuitBreaker(enabled, settings);
+}
+
+// Adapt the number of requests in flight on each node to its answers.
+void ElasticSearch::setConcurrencyLimiter(bool enabled, const ConcurrencyLimiter::Settings& settings){
+    _pool.setConcurrencyLimiter(enabled, settings);
+}
+
+// Retry the failed requests that are safe to send twice.
+void ElasticSearch::setRetryPolicy(const std::shared_ptr<const RetryPolicy>& policy){
+    _pool.setRetryPolicy(policy);
+}
+
+// Time left to the request as a timeout parameter, so the cluster gives up when the caller does.
+std::string ElasticSearch::timeoutParameter(char separator) const {
+    const RequestContext& context = RequestContext::current();
+    const Timeouts timeouts = _pool.timeouts();
+    if(!context.hasDeadline() && timeouts.request.count() == 0)
+        return std::string();
+
+    std::chrono::milliseconds limit = (timeouts.request.count() > 0) ? timeouts.request : std::chrono::milliseconds::max();
+    std::chrono::milliseconds left = context.remaining(limit);
+
+    return separator + std::string("timeout=") + std::to_string(std::max<long long>(left.count(), 1)) + "ms";
+}
+
+// Request on the node holding the shard of the document if shard routing is enabled.
+unsigned int ElasticSearch::documentRequest(const char* method, const std::string& index, const std::string& id, bool write, const char* endUrl, const char* data, Json::Object* root){
+    Result result;
+    std::string node = _router ? _router->node(index, id, write) : std::string();
+
+    // Reads may be hedged, another copy of the shard answers if the node is slow.
+    if(!write)
+        return _pool.hedgedRequest(node, method, endUrl, data, root, result);
+
+    if(node.empty())
+        return _pool.request(method, endUrl, data, root, result);
+
+    return _pool.request(node, method, endUrl, data, root, result);
+}
+
+// Write request on the document, the cached copy is invalidated even if the request throws.
+unsigned int ElasticSearch::writeDocument(const char* method, const std::string& index, const std::string& type, const std::string& id, const char* endUrl, const char* data, Json::Object& result){
+    unsigned int statusCode = 0;
+    try {
+        statusCode = documentRequest(method, index, id, true, endUrl, data, &result);
+    }
+    catch(...) {
+        // The write may have applied before the failure, the written version is unknown.
+        invalidateDocument(index, type, id, Json::Object());
+        throw;
+    }
+
+    invalidateDocument(index, type, id, result);
+    return statusCode;
+}
+
+// Write request on many documents, the cache is cleared even if the request throws.
+unsigned int ElasticSearch::writeDocuments(const char* method, const char* endUrl, const char* data, Json::Object* root){
+    Result result;
+    unsigned int statusCode = 0;
+    try {
+        statusCode = _pool.request(method, endUrl, data, root, result);
+    }
+    catch(...) {
+        invalidateDocuments();
+        throw;
+    }
+
+    invalidateDocuments();
+    return statusCode;
+}
+
 // Request the document by index/type/ query key:value.
 void ElasticSearch::getDocument(const std::string& index, const std::string& type, const std::string& key, const std::string& value, Json::Object& msg){
     std::ostringstream oss;
-    oss << index << "/" << type << "/_search";
+    oss << index << "/" << type << "/_search" << timeoutParameter('?');
     std::stringstream query;
     query << "{\"query\":{\"match\":{\""<< key << "\":\"" << value << "\"}}}";
-    _http.post(oss.str().c_str(), query.str().c_str(), &msg);
+    _pool.post(oss.str().c_str(), query.str().c_str(), &msg);
 }
 
 /// Delete the document by index/type/id.
@@ -72,9 +458,9 @@ bool ElasticSearch::deleteDocument(const char* index, const char* type, const ch
         return false;
 
     std::ostringstream oss;
-    oss << index << "/" << type << "/" << id;
+    oss << index << "/" << type << "/" << id << "?filter_path=found,_version" << timeoutParameter('&');
     Json::Object msg;
-    _http.remove(oss.str().c_str(), 0, &msg);
+    writeDocument("DELETE", index, type, id, oss.str().c_str(), 0, msg);
 
     return msg.getValue("found");
 }
@@ -85,10 +471,10 @@ bool ElasticSearch::deleteAll(const char* index, const char* type){
         return false;
 
     std::ostringstream uri, data;
-    uri << index << "/" << type << "/_query";
+    uri << index << "/" << type << "/_query?filter_path=_indices.*._shards.failed";
     data << "{\"query\":{\"match_all\": {}}}";
     Json::Object msg;
-    _http.remove(uri.str().c_str(), data.str().c_str(), &msg);
+    writeDocuments("DELETE", uri.str().c_str(), data.str().c_str(), &msg);
 
     if(!msg.member("_indices") || !msg["_indices"].getObject().member(index) || !msg["_indices"].getObject()[index].getObject().member("_shards"))
         return false;
@@ -102,29 +488,35 @@ bool ElasticSearch::deleteAll(const char* index, const char* type){
 // Request the document number of type T in index I.
 long unsigned int ElasticSearch::getDocumentCount(const char* index, const char* type){
     std::ostringstream oss;
-    oss << index << "/" << type << "/_count";
+    oss << index << "/" << type << "/_count?filter_path=count";
     Json::Object msg;
-    _http.get(oss.str().c_str(),0,&msg);
+    _pool.get(oss.str().c_str(),0,&msg);
 
     size_t pos = 0;
     if(msg.member("count"))
         pos = msg.getValue("count").getUnsignedInt();
     else
-        printf("We did not find \"count\" member.\n");
+        ES_LOG(WARNING, "We did not find \"count\" member in the response of " << oss.str() << ".");
 
     return pos;
 }
 
 // Test if document exists
 bool ElasticSearch::exist(const std::string& index, const std::string& type, const std::string& id){
-    std::stringstream url;
-    url << index << "/" << type << "/" << id;
-
     Json::Object result;
-    _http.get(url.str().c_str(), 0, &result);
+
+    if(_cache && _cache->get(index, type, id, result))
+        return true;
+
+    bool found = false;
+    if(!_batcher || !_batcher->get(index, type, id, result, found, false)) {
+        std::stringstream url;
+        url << index << "/" << type << "/" << id << "?_source=false&filter_path=found";
+        documentRequest("GET", index, id, false, url.str().c_str(), 0, &result);
+    }
 
     if(!result.member("found")){
-        std::cout << result << std::endl;
+        ES_LOG(ERROR, "Field \"found\" missing for " << index << "/" << type << "/" << id << ": " << result);
         EXCEPTION("Database exception, field \"found\" must exist.");
     }
 
@@ -138,23 +530,27 @@ bool ElasticSearch::index(const std::string& index, const std::string& type, con
         return false;
 
     std::stringstream url;
-    url << index << "/" << type << "/" << id;
+    url << index << "/" << type << "/" << id << "?filter_path=created,_version" << timeoutParameter('&');
+    const std::string endUrl = url.str();
 
     std::stringstream data;
     data << jData;
+    const std::string body = data.str();
+
+    SlowQueryTimer timer(_slowLog.get(), "PUT", endUrl, body.c_str());
 
     Json::Object result;
-    _http.put(url.str().c_str(), data.str().c_str(), &result);
+    timer.status(writeDocument("PUT", index, type, id, endUrl.c_str(), body.c_str(), result));
 
     if(!result.member("created"))
         EXCEPTION("The index induces error.");
 
-    if(result.getValue("created"))
+    if(result.getValue("created")) {
+        timer.succeeded();
         return true;
+    }
 
-    std::cout << "endPoint: " << index << "/" << type << "/" << id << std::endl;
-    std::cout << "jData" << jData.pretty() << std::endl;
-    std::cout << "result" << result.pretty() << std::endl;
+    ES_LOG(ERROR, "Index of " << index << "/" << type << "/" << id << " not created.");
 
     EXCEPTION("The index returns ok: false.");
     return false;
@@ -167,21 +563,24 @@ std::string ElasticSearch::index(const std::string& index, const std::string& ty
         return "";
 
     std::stringstream url;
-    url << index << "/" << type << "/";
+    url << index << "/" << type << "/?filter_path=created,_id" << timeoutParameter('&');
+    const std::string endUrl = url.str();
 
     std::stringstream data;
     data << jData;
+    const std::string body = data.str();
+
+    SlowQueryTimer timer(_slowLog.get(), "POST", endUrl, body.c_str());
 
     Json::Object result;
-    _http.post(url.str().c_str(), data.str().c_str(), &result);
+    timer.status(_pool.post(endUrl.c_str(), body.c_str(), &result));
 
     if(!result.member("created") || !result.getValue("created")){
-        std::cout << "url: " << url.str() << std::endl;
-        std::cout << "data: " << data.str() << std::endl;
-        std::cout << "result: " << result.str() << std::endl;
+        ES_LOG(ERROR, "Index at " << endUrl << " failed.");
         EXCEPTION("The index induces error.");
     }
 
+    timer.succeeded();
     return result.getValue("_id").getString();
 }
 
@@ -191,13 +590,13 @@ bool ElasticSearch::update(const std::string& index, const std::string& type, co
         return false;
 
     std::stringstream url;
-    url << index << "/" << type << "/" << id << "/_update";
+    url << index << "/" << type << "/" << id << "/_update?filter_path=_version" << timeoutParameter('&');
 
     std::stringstream data;
     data << "{\"doc\":{\"" << key << "\":\""<< value << "\"}}";
 
     Json::Object result;
-    _http.post(url.str().c_str(), data.str().c_str(), &result);
+    writeDocument("POST", index, type, id, url.str().c_str(), data.str().c_str(), result);
 
     if(!result.member("_version"))
         EXCEPTION("The update failed.");
@@ -211,14 +610,14 @@ bool ElasticSearch::update(const std::string& index, const std::string& type, co
         return false;
 
     std::stringstream url;
-    url << index << "/" << type << "/" << id << "/_update";
+    url << index << "/" << type << "/" << id << "/_update?filter_path=error,_version" << timeoutParameter('&');
 
     std::stringstream data;
     data << "{\"doc\":" << jData;
     data << "}";
 
     Json::Object result;
-    _http.post(url.str().c_str(), data.str().c_str(), &result);
+    writeDocument("POST", index, type, id, url.str().c_str(), data.str().c_str(), result);
 
     if(result.member("error"))
         EXCEPTION("The update doccument fields failed.");
@@ -233,14 +632,14 @@ bool ElasticSearch::upsert(const std::string& index, const std::string& type, co
         return false;
 
     std::stringstream url;
-    url << index << "/" << type << "/" << id << "/_update";
+    url << index << "/" << type << "/" << id << "/_update?filter_path=error,_version" << timeoutParameter('&');
 
     std::stringstream data;
     data << "{\"doc\":" << jData;
     data << ", \"doc_as_upsert\" : true}";
 
     Json::Object result;
-    _http.post(url.str().c_str(), data.str().c_str(), &result);
+    writeDocument("POST", index, type, id, url.str().c_str(), data.str().c_str(), result);
 
     if(result.member("error"))
         EXCEPTION("The update doccument fields failed.");
@@ -249,25 +648,33 @@ bool ElasticSearch::upsert(const std::string& index, const std::string& type, co
 }
 
 /// Search API of ES.
-long ElasticSearch::search(const std::string& index, const std::string& type, const std::string& query, Json::Object& result){
+long ElasticSearch::search(const std::string& index, const std::string& type, const std::string& query, Json::Object& result, const std::vector<std::string>& sourceIncludes){
 
     std::stringstream url;
     url << index << "/" << type << "/_search";
 
+    if(!sourceIncludes.empty())
+        url << "?_source_includes=" << joinFields(sourceIncludes);
+
+    url << timeoutParameter(sourceIncludes.empty() ? '?' : '&');
+    const std::string endUrl = url.str();
 
-    _http.post(url.str().c_str(), query.c_str(), &result);
+    SlowQueryTimer timer(_slowLog.get(), "POST", endUrl, query.c_str());
+
+    Result res;
+    timer.status(_pool.hedgedRequest(std::string(), "POST", endUrl.c_str(), query.c_str(), &result, res));
 
     if(!result.member("timed_out")){
-        std::cout << url.str() << " -d " << query << std::endl;
-        std::cout << "result: " << result << std::endl;
+        ES_LOG(ERROR, "Search " << endUrl << " failed.");
         EXCEPTION("Search failed.");
     }
 
     if(result.getValue("timed_out")){
-        std::cout << "result: " << result << std::endl;
+        ES_LOG(WARNING, "Search " << endUrl << " timed out.");
         EXCEPTION("Search timed out.");
     }
 
+    timer.succeeded();
     return result.getValue("hits").getObject().getValue("total").getLong();
 }
 
@@ -275,22 +682,22 @@ long ElasticSearch::search(const std::string& index, const std::string& type, co
 bool ElasticSearch::deleteType(const std::string& index, const std::string& type){
     std::ostringstream uri;
     uri << index << "/" << type;
-    return (200 == _http.remove(uri.str().c_str(), 0, 0));
+    return (200 == writeDocuments("DELETE", uri.str().c_str(), 0, 0));
 }
 
 // Test if index exists
 bool ElasticSearch::exist(const std::string& index){
-    return (200 == _http.head(index.c_str(), 0, 0));
+    return (200 == _pool.head(index.c_str(), 0, 0));
 }
 
 // Create index, optionally with data (settings, mappings etc)
 bool ElasticSearch::createIndex(const std::string& index, const char* data){
-    return (200 == _http.put(index.c_str(), data, 0));
+    return (200 == _pool.put(index.c_str(), data, 0));
 }
 
 // Delete given index (and all types, documents, mappings)
 bool ElasticSearch::deleteIndex(const std::string& index){
-    return (200 == _http.remove(index.c_str(), 0, 0));
+    return (200 == writeDocuments("DELETE", index.c_str(), 0, 0));
 }
 
 // Refresh the index.
@@ -299,15 +706,20 @@ void ElasticSearch::refresh(const std::string& index){
     oss << index << "/_refresh";
 
     Json::Object msg;
-    _http.get(oss.str().c_str(), 0, &msg);
+    _pool.get(oss.str().c_str(), 0, &msg);
 }
 
-bool ElasticSearch::initScroll(std::string& scrollId, const std::string& index, const std::string& type, const std::string& query, int scrollSize) {
+bool ElasticSearch::initScroll(std::string& scrollId, const std::string& index, const std::string& type, const std::string& query, int scrollSize, const std::vector<std::string>& sourceIncludes) {
     std::ostringstream oss;
-    oss << index << "/" << type << "/_search?scroll=1m&search_type=scan&size=" << scrollSize;
+    oss << index << "/" << type << "/_search?scroll=1m&search_type=scan&size=" << scrollSize << "&filter_path=_scroll_id";
+
+    if(!sourceIncludes.empty())
+        oss << "&_source_includes=" << joinFields(sourceIncludes);
+
+    oss << timeoutParameter('&');
 
     Json::Object msg;
-    if (200 != _http.post(oss.str().c_str(), query.c_str(), &msg))
+    if (200 != _pool.post(oss.str().c_str(), query.c_str(), &msg))
         return false;
     
     scrollId = msg["_scroll_id"].getString();
@@ -316,7 +728,7 @@ bool ElasticSearch::initScroll(std::string& scrollId, const std::string& index,
 
 bool ElasticSearch::scrollNext(std::string& scrollId, Json::Array& resultArray) {
     Json::Object msg;
-    if (200 != _http.post("/_search/scroll?scroll=1m", scrollId.c_str(), &msg))
+    if (200 != _pool.post("/_search/scroll?scroll=1m&filter_path=_scroll_id,hits.hits", scrollId.c_str(), &msg))
         return false;
     
     scrollId = msg["_scroll_id"].getString();
@@ -326,14 +738,14 @@ bool ElasticSearch::scrollNext(std::string& scrollId, Json::Array& resultArray)
 }
 
 void ElasticSearch::clearScroll(const std::string& scrollId) {
-    _http.remove("/_search/scroll", scrollId.c_str(), 0);
+    _pool.remove("/_search/scroll", scrollId.c_str(), 0);
 }
 
-int ElasticSearch::fullScan(const std::string& index, const std::string& type, const std::string& query, Json::Array& resultArray, int scrollSize) {
+int ElasticSearch::fullScan(const std::string& index, const std::string& type, const std::string& query, Json::Array& resultArray, int scrollSize, const std::vector<std::string>& sourceIncludes) {
     resultArray.clear();
     
     std::string scrollId;
-    if (!initScroll(scrollId, index, type, query, scrollSize))
+    if (!initScroll(scrollId, index, type, query, scrollSize, sourceIncludes))
         return 0;
 
     size_t currentSize=0, newSize;
@@ -348,6 +760,179 @@ int ElasticSearch::fullScan(const std::string& index, const std::string& type, c
     return currentSize;
 }
 
+// Open a point in time on the index.
+bool ElasticSearch::openPointInTime(std::string& pitId, const std::string& index, const std::string& keepAlive) {
+    std::ostringstream oss;
+    oss << index << "/_pit?keep_alive=" << keepAlive;
+
+    Json::Object msg;
+    if (200 != _pool.post(oss.str().c_str(), 0, &msg) || !msg.member("id"))
+        return false;
+
+    pitId = msg["id"].getString();
+    return true;
+}
+
+// Close a point in time prior to its keep alive timeout.
+void ElasticSearch::closePointInTime(const std::string& pitId) {
+    std::ostringstream data;
+    data << "{\"id\":\"" << Json::Value::escapeJsonString(pitId) << "\"}";
+    _pool.remove("_pit", data.str().c_str(), 0);
+}
+
+// Build the body of the next search_after request from the user query.
+static std::string searchAfterBody(const SearchAfterCursor& cursor) {
+
+    Json::Object query;
+    if(!cursor.query.empty())
+        query.addMember(cursor.query.c_str(), cursor.query.c_str() + cursor.query.size());
+
+    std::ostringstream body;
+    body << "{";
+
+    // Copy the user members, the pagination ones are ours.
+    for(Json::Object::const_iterator it = query.begin(); it != query.end(); ++it) {
+        if(it.key() == "size" || it.key() == "from" || it.key() == "pit" || it.key() == "search_after")
+            continue;
+        body << "\"" << it.key() << "\":" << it.value() << ",";
+    }
+
+    // A PIT search implicitly adds _shard_doc as tiebreaker to any user sort.
+    if(!query.member("sort"))
+        body << "\"sort\":[{\"_shard_doc\":\"asc\"}],";
+
+    body << "\"size\":" << cursor.pageSize;
+    body << ",\"pit\":{\"id\":\"" << Json::Value::escapeJsonString(cursor.pitId) << "\",\"keep_alive\":\"" << Json::Value::escapeJsonString(cursor.keepAlive) << "\"}";
+
+    if(!cursor.searchAfter.empty())
+        body << ",\"search_after\":" << cursor.searchAfter;
+
+    body << "}";
+    return body.str();
+}
+
+// Field ending the sort of the user query, empty if none.
+static std::string lastSortField(const std::string& queryString) {
+    if(queryString.empty())
+        return std::string();
+
+    Json::Object query;
+    query.addMember(queryString.c_str(), queryString.c_str() + queryString.size());
+    if(!query.member("sort"))
+        return std::string();
+
+    // The sort is a field, an object by field, or an array of them.
+    const Json::Value* last = &query.getValue("sort");
+    if(last->isArray()) {
+        const Json::Value* element = 0;
+        for(const Json::Value& value : last->getArray())
+            element = &value;
+
+        if(element == 0)
+            return std::string();
+        last = element;
+    }
+
+    if(last->isObject())
+        return last->getObject().empty() ? std::string() : last->getObject().begin().key();
+
+    if(last->isArray() || last->isNull())
+        return std::string();
+
+    return last->getString();
+}
+
+// Tells if the cursor may go on from its sort values on a new point in time.
+static bool restartable(const SearchAfterCursor& cursor) {
+
+    // Before the first page there is nothing to resume.
+    if(cursor.searchAfter.empty())
+        return true;
+
+    // The _shard_doc tiebreaker only orders the documents of its own PIT, a unique field must decide before it.
+    return !cursor.uniqueField.empty() && lastSortField(cursor.query) == cursor.uniqueField;
+}
+
+// Throw if the cursor cannot go on from its sort values on a new point in time.
+static void requireRestartable(const SearchAfterCursor& cursor) {
+    if(!restartable(cursor))
+        EXCEPTION("The point in time of the search_after cursor is gone, it can only restart when the sort ends with its unique field.");
+}
+
+// Initialize a search_after cursor over a new point in time.
+bool ElasticSearch::initSearchAfter(SearchAfterCursor& cursor, const std::string& index, const std::string& query, int pageSize, const std::string& keepAlive, const std::string& uniqueField) {
+    cursor.index = index;
+    cursor.query = query;
+    cursor.keepAlive = keepAlive;
+    cursor.pageSize = pageSize;
+    cursor.uniqueField = uniqueField;
+    cursor.searchAfter.clear();
+    cursor.pitId.clear();
+
+    return openPointInTime(cursor.pitId, index, keepAlive);
+}
+
+// Fetch the next page of a search_after cursor.
+bool ElasticSearch::searchAfterNext(SearchAfterCursor& cursor, Json::Array& resultArray) {
+
+    // Restart from the last sort values on a new point in time if it was closed.
+    if(cursor.pitId.empty()) {
+        requireRestartable(cursor);
+        if(!openPointInTime(cursor.pitId, cursor.index, cursor.keepAlive))
+            return false;
+    }
+
+    Json::Object msg;
+    unsigned int status = _pool.post(("_search" + timeoutParameter('?')).c_str(), searchAfterBody(cursor).c_str(), &msg);
+
+    // The point in time expired, restart from the last sort values on a new one.
+    if(status == 404) {
+        requireRestartable(cursor);
+
+        cursor.pitId.clear();
+        if(!openPointInTime(cursor.pitId, cursor.index, cursor.keepAlive))
+            return false;
+
+        msg.clear();
+        status = _pool.post(("_search" + timeoutParameter('?')).c_str(), searchAfterBody(cursor).c_str(), &msg);
+    }
+
+    if(status != 200)
+        return false;
+
+    // The point in time id may change between pages.
+    if(msg.member("pit_id"))
+        cursor.pitId = msg["pit_id"].getString();
+
+    appendHitsToArray(msg, resultArray);
+
+    // Move the cursor after the last hit of the page.
+    const Json::Value* lastHit = 0;
+    for(const Json::Value& value : msg["hits"].getObject()["hits"].getArray())
+        lastHit = &value;
+
+    if(lastHit == 0)
+        return true;
+
+    if(!lastHit->getObject().member("sort"))
+        EXCEPTION("Result corrupted, no member \"sort\" in hit.");
+
+    std::ostringstream searchAfter;
+    searchAfter << lastHit->getObject()["sort"];
+    cursor.searchAfter = searchAfter.str();
+
+    return true;
+}
+
+// Close the point in time of the cursor.
+void ElasticSearch::clearSearchAfter(SearchAfterCursor& cursor) {
+    if(cursor.pitId.empty())
+        return;
+
+    closePointInTime(cursor.pitId);
+    cursor.pitId.clear();
+}
+
 void ElasticSearch::appendHitsToArray(const Json::Object& msg, Json::Array& resultArray) {
 
     if(!msg.member("hits"))
@@ -366,7 +951,32 @@ bool ElasticSearch::bulk(const char* data, Json::Object& jResult) {
 	 if(_readOnly)
 		return false;
 
-	return (200 == _http.post("/_bulk", data, &jResult));
+	const std::string endUrl = "/_bulk" + timeoutParameter('?');
+	SlowQueryTimer timer(_slowLog.get(), "POST", endUrl, data);
+
+	unsigned int statusCode = writeDocuments("POST", endUrl.c_str(), data, &jResult);
+	timer.status(statusCode);
+
+	if(statusCode != 200)
+		return false;
+
+	timer.succeeded();
+	return true;
+}
+
+// Multi search API of ES.
+bool ElasticSearch::msearch(MultiSearchBuilder& builder, MultiSearchResult& result) {
+    result.clear();
+
+    if(builder.isEmpty())
+        return true;
+
+    std::string output;
+    Result res;
+    if(200 != _pool.request("POST", "_msearch", builder.str().c_str(), output, res, "application/x-ndjson") || res != OK)
+        return false;
+
+    return result.assign(output);
 }
 
 BulkBuilder::BulkBuilder() {}
@@ -442,3 +1052,199 @@ void BulkBuilder::clear() {
 bool BulkBuilder::isEmpty() {
 	return operations.empty();
 }
+
+
+MultiSearchBuilder::MultiSearchBuilder() {}
+
+// Query on one line of the NDJSON body. A line break is only whitespace between Json tokens, a blank keeps the query.
+static std::string compactQuery(const std::string &query) {
+	std::string line(query);
+	for(auto &c : line) {
+		if(c == '\n' || c == '\r')
+			c = ' ';
+	}
+
+	return line;
+}
+
+void MultiSearchBuilder::search(const std::string &index, const std::string &type, const std::string &query) {
+	std::ostringstream header;
+	header << "{\"index\":\"" << Json::Value::escapeJsonString(index) << "\",\"type\":\"" << Json::Value::escapeJsonString(type) << "\"}";
+	lines.push_back(header.str());
+	lines.push_back(compactQuery(query));
+}
+
+void MultiSearchBuilder::search(const std::string &index, const std::string &query) {
+	std::ostringstream header;
+	header << "{\"index\":\"" << Json::Value::escapeJsonString(index) << "\"}";
+	lines.push_back(header.str());
+	lines.push_back(compactQuery(query));
+}
+
+std::string MultiSearchBuilder::str() {
+	std::string ndjson;
+
+	for(auto &line : lines) {
+		ndjson += line;
+		ndjson += '\n';
+	}
+
+	return ndjson;
+}
+
+void MultiSearchBuilder::clear() {
+	lines.clear();
+}
+
+bool MultiSearchBuilder::isEmpty() {
+	return lines.empty();
+}
+
+size_t MultiSearchBuilder::size() {
+	return lines.size() / 2;
+}
+
+// Skip white spaces.
+static const char* skipSpaces(const char* p, const char* end) {
+    while(p < end && isspace(*p))
+        ++p;
+    return p;
+}
+
+// Skip a Json string starting at its opening quote, returns the position after the closing quote.
+static const char* skipString(const char* p, const char* end) {
+    for(++p; p < end; ++p) {
+        if(*p == '\\')
+            ++p;
+        else if(*p == '"')
+            return p + 1;
+    }
+    return end;
+}
+
+// Skip a Json value without parsing it, returns the position after the value.
+static const char* skipValue(const char* p, const char* end) {
+    if(p < end && *p == '"')
+        return skipString(p, end);
+
+    int depth = 0;
+    while(p < end) {
+        switch(*p) {
+            case '"':
+                p = skipString(p, end);
+                continue;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if(depth == 0)
+                    return p;
+                if(--depth == 0)
+                    return p + 1;
+                break;
+            case ',':
+                if(depth == 0)
+                    return p;
+                break;
+        }
+        ++p;
+    }
+    return end;
+}
+
+MultiSearchResult::MultiSearchResult() {}
+
+// Response of the i-th search, parsed on first access.
+const Json::Object& MultiSearchResult::operator[](size_t i) const {
+    if(i >= _slots.size())
+        EXCEPTION("Multi search response out of range.");
+
+    if(!_parsed[i]) {
+        const char* start = _raw.c_str() + _slots[i].first;
+        _parsed[i].reset(new Json::Object);
+        _parsed[i]->addMember(start, start + _slots[i].second);
+    }
+
+    return *_parsed[i];
+}
+
+// Raw Json text of the i-th response.
+std::string MultiSearchResult::raw(size_t i) const {
+    if(i >= _slots.size())
+        EXCEPTION("Multi search response out of range.");
+
+    return _raw.substr(_slots[i].first, _slots[i].second);
+}
+
+// Split the raw response into slots, the responses are not parsed.
+bool MultiSearchResult::assign(std::string& raw) {
+    clear();
+    _raw.swap(raw);
+
+    const char* begin = _raw.c_str();
+    const char* end = begin + _raw.size();
+    const char* p = skipSpaces(begin, end);
+
+    if(p == end || *p != '{')
+        return false;
+
+    // Look for the responses array among the top level members.
+    for(++p; p < end; ) {
+        p = skipSpaces(p, end);
+        if(p == end || *p == '}')
+            break;
+
+        if(*p == ',') {
+            ++p;
+            continue;
+        }
+
+        if(*p != '"')
+            return false;
+
+        const char* keyEnd = skipString(p, end);
+        bool responses = (keyEnd - p == 11 && strncmp(p, "\"responses\"", 11) == 0);
+
+        p = skipSpaces(keyEnd, end);
+        if(p == end || *p != ':')
+            return false;
+        p = skipSpaces(p + 1, end);
+
+        if(!responses) {
+            p = skipValue(p, end);
+            continue;
+        }
+
+        if(p == end || *p != '[')
+            return false;
+
+        for(++p; p < end; ) {
+            p = skipSpaces(p, end);
+            if(p == end || *p == ']')
+                break;
+
+            if(*p == ',') {
+                ++p;
+                continue;
+            }
+
+            const char* valueEnd = skipValue(p, end);
+            _slots.push_back(std::make_pair(p - begin, valueEnd - p));
+            p = valueEnd;
+        }
+
+        _parsed.resize(_slots.size());
+        return true;
+    }
+
+    return false;
+}
+
+// Clear the responses.
+void MultiSearchResult::clear() {
+    _raw.clear();
+    _slots.clear();
+    _parsed.clear();
+}
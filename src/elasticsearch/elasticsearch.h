@@ -6,25 +6,158 @@
 #include <list>
 #include <mutex>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
 
 #include "http/http.h"
+#include "http/pool.h"
+#include "http/context.h"
 #include "json/json.h"
 
+/// Identifier of a document by index/type/id.
+struct DocumentId {
+    std::string index;
+    std::string type;
+    std::string id;
+};
+
+class MultiGetBatcher;
+class DocumentCache;
+class ShardRouter;
+class SlowQueryLog;
+class MultiSearchBuilder;
+class MultiSearchResult;
+
+/// Cursor of a search_after deep pagination over a point in time (PIT).
+/// Only the PIT id and the sort values of the last hit are kept, so the cursor can be saved and
+/// the pagination restarted from searchAfter, even after the PIT expired.
+/// The sort values end with the _shard_doc tiebreaker of the PIT, which means nothing on another PIT:
+/// a restart on a new PIT is only exact, and only allowed, when the user sort ends with uniqueField,
+/// a field unique per document as an id keyword. Otherwise the restart throws.
+struct SearchAfterCursor {
+    /// Index the point in time is opened on.
+    std::string index;
+
+    /// Search body (query, sort, _source, ...) without size, pit and search_after.
+    std::string query;
+
+    /// Point in time id, updated after each page.
+    std::string pitId;
+
+    /// Point in time keep alive, extended at each page.
+    std::string keepAlive;
+
+    /// Json array of the sort values of the last returned hit, empty before the first page.
+    std::string searchAfter;
+
+    /// Number of hits per page.
+    int pageSize;
+
+    /// Field unique per document ending the user sort, empty if none so the cursor cannot restart on a new PIT.
+    std::string uniqueField;
+};
+
 /// API class for elastic search server.
 /// Node: Instance of elastic search on server represented by url:port
+/// Requests are spread over the nodes given at construction.
 class ElasticSearch {
     public:
         ElasticSearch(const std::string& node, bool readOnly = false);
+        ElasticSearch(const std::vector<std::string>& nodes, bool readOnly = false, ConnectionPool::Selection selection = ConnectionPool::ROUND_ROBIN);
         ~ElasticSearch();
 
          /// Test connection with node.
         bool isActive();
 
+        /// Discover the nodes of the cluster with _nodes/http and balance the requests over them. Returns false on error.
+        bool sniff();
+
+        /// Sniff the nodes in background at every interval, until stopSniffing or destruction.
+        void startSniffing(std::chrono::seconds interval);
+
+        /// Stop the background sniffing.
+        void stopSniffing();
+
         /// Request document number of type T in index I.
         long unsigned int getDocumentCount(const char* index, const char* type);
 
-        /// Request the document by index/type/id.
-        bool getDocument(const char* index, const char* type, const char* id, Json::Object& msg);
+        /// Request the document by index/type/id, optionally restricted to some fields of the source.
+        bool getDocument(const char* index, const char* type, const char* id, Json::Object& msg, const std::vector<std::string>& sourceIncludes = std::vector<std::string>(), const std::vector<std::string>& sourceExcludes = std::vector<std::string>());
+
+        /// Request the documents by index/type/ids with a single _mget, documents are appended to docs in the ids order.
+        bool mget(const std::string& index, const std::string& type, const std::vector<std::string>& ids, Json::Array& docs);
+
+        /// Request the documents by index/type/id with a single _mget, documents are appended to docs in the ids order.
+        bool mget(const std::vector<DocumentId>& ids, Json::Array& docs);
+
+        /// Same with the source of each document requested or not, by index in ids. An empty sources requests every source.
+        bool mget(const std::vector<DocumentId>& ids, const std::vector<bool>& sources, Json::Array& docs);
+
+        /// Combine concurrent getDocument/exist by id from many threads into one _mget per window. A zero window disables it.
+        /// Must be set before the client is shared between threads.
+        void setAutoBatching(std::chrono::microseconds window, size_t maxBatchSize = 1000);
+
+        /// Cache the documents fetched by id, up to capacity documents for at most ttl. Writes through this client invalidate them.
+        /// A zero capacity disables it. Must be set before the client is shared between threads.
+        void setDocumentCache(size_t capacity, std::chrono::milliseconds ttl, size_t shardCount = 16);
+
+        /// Send getDocument, exist, index, update, upsert and deleteDocument by id straight to a node holding the shard of the document.
+        /// The routing table is refreshed at the given period, zero disables it. Must be set before the client is shared between threads.
+        void setShardRouting(std::chrono::seconds refresh);
+
+        /// Compress with gzip the request bodies of at least threshold bytes, zero disables it, as the 50MB bulks.
+        /// Also ask the nodes to compress their responses if acceptEncoding, http.compression must be enabled on the cluster.
+        void setCompression(size_t threshold, bool acceptEncoding = true);
+
+        /// Default timeouts of the requests. A tighter deadline and a cancellation token may be given to any call
+        /// with a RequestContext::Scope, the time left is sent to the cluster as the timeout parameter of searches and writes.
+        /// This setter and the ones of the sockets, trace hook, retries, hedging, breaker and limiter below may be called
+        /// while the client is shared, each request keeps the settings it started with.
+        void setTimeouts(const Timeouts& timeouts);
+
+        /// Tuning of the sockets of the connections: TCP_NODELAY (on by default), kernel buffer sizes,
+        /// keepalive probes and TCP_QUICKACK.
+        void setSocketOptions(const SocketOptions& options);
+
+        /// Follow every request sent to the cluster for distributed tracing: the hook is told when a request starts,
+        /// and may add headers such as the W3C traceparent, when it is written, when the response starts and when it is over,
+        /// with the sizes and the timings. Each retry or hedged duplicate is a request of its own. Null for none, the default,
+        /// which costs a test per step.
+        void setTraceHook(const std::shared_ptr<TraceHook>& hook);
+
+        /// Retry the failed requests that are safe to send twice, on another node if any. By default 3 attempts
+        /// with exponential backoff on no answer, 429, 502, 503 and 504. Null disables the retries.
+        void setRetryPolicy(const std::shared_ptr<const RetryPolicy>& policy);
+
+        /// Hedge search, getDocument and exist by id: when no answer came after the latency at percentile (0.99 for p99)
+        /// of the recent ones, the request is duplicated on another node and the first answer wins. initialDelay is used
+        /// until enough requests are measured, a zero percentile disables it.
+        void setHedging(double percentile, std::chrono::milliseconds initialDelay = std::chrono::milliseconds(50));
+
+        /// Stop sending requests to a node for a while when too many of its requests fail (no answer, 429, 5xx) or are slow.
+        /// Disabled by default.
+        void setCircuitBreaker(bool enabled, const CircuitBreaker::Settings& settings = CircuitBreaker::Settings());
+
+        /// Adapt the number of requests in flight on each node to its answers (AIMD), the requests over the limit wait
+        /// for a slot so that an overloaded cluster is not hammered. Disabled by default.
+        void setConcurrencyLimiter(bool enabled, const ConcurrencyLimiter::Settings& settings = ConcurrencyLimiter::Settings());
+
+        /// Counters of the connections (opened, reused, failed, closed), the requests by method and status code,
+        /// the bytes and system calls, the body delimitations and the retries since the client was created.
+        inline HTTPStats httpStats() const { return _pool.stats(); }
+
+        /// Keep the last capacity search, index and bulk operations slower than threshold, or failed, in a fixed ring with their
+        /// endpoint, the start of the request body, the status, the response size and the phase timings. Recording never blocks.
+        /// A zero capacity disables it, the default. Must be set before the client is shared between threads.
+        void setSlowQueryLog(std::chrono::milliseconds threshold, size_t capacity = 256);
+
+        /// The slow query log, null if disabled.
+        inline const SlowQueryLog* slowQueryLog() const { return _slowLog.get(); }
+
+        /// The slow operations recorded so far as text, one line each, oldest first.
+        std::string dumpSlowQueries() const;
 
         /// Request the document by index/type/ query key:value.
         void getDocument(const std::string& index, const std::string& type, const std::string& key, const std::string& value, Json::Object& msg);
@@ -56,12 +189,15 @@ class ElasticSearch {
         /// Update or insert if the document does not already exists.
         bool upsert(const std::string& index, const std::string& type, const std::string& id, const Json::Object& jData);
 
-        /// Search API of ES. Specify the doc type.
-        long search(const std::string& index, const std::string& type, const std::string& query, Json::Object& result);
+        /// Search API of ES. Specify the doc type, hits source may be restricted to the given fields.
+        long search(const std::string& index, const std::string& type, const std::string& query, Json::Object& result, const std::vector<std::string>& sourceIncludes = std::vector<std::string>());
 
         // Bulk API
         bool bulk(const char*, Json::Object& jResult);
 
+        /// Multi search API of ES, sends all the searches of the builder in one request. Returns false on error.
+        bool msearch(MultiSearchBuilder& builder, MultiSearchResult& result);
+
     public:
         /// Delete given type (and all documents, mappings)
         bool deleteType(const std::string& index, const std::string& type);
@@ -81,7 +217,7 @@ class ElasticSearch {
 
     public:
         /// Initialize a scroll search. Use the returned scroll id when calling scrollNext. Size is based on shardSize. Returns false on error
-        bool initScroll(std::string& scrollId, const std::string& index, const std::string& type, const std::string& query, int scrollSize = 1000);
+        bool initScroll(std::string& scrollId, const std::string& index, const std::string& type, const std::string& query, int scrollSize = 1000, const std::vector<std::string>& sourceIncludes = std::vector<std::string>());
 
         /// Scroll to next matches of an initialized scroll search. scroll_id may be updated. End is reached when resultArray.empty() is true (in which scroll is automatically cleared). Returns false on error.
         bool scrollNext(std::string& scrollId, Json::Array& resultArray);
@@ -90,20 +226,80 @@ class ElasticSearch {
         void clearScroll(const std::string& scrollId);
 
         /// Perform a scan to get all results from a query.
-        int fullScan(const std::string& index, const std::string& type, const std::string& query, Json::Array& resultArray, int scrollSize = 1000);
+        int fullScan(const std::string& index, const std::string& type, const std::string& query, Json::Array& resultArray, int scrollSize = 1000, const std::vector<std::string>& sourceIncludes = std::vector<std::string>());
+
+    public:
+        /// Open a point in time on the index. Returns false on error.
+        bool openPointInTime(std::string& pitId, const std::string& index, const std::string& keepAlive = "1m");
+
+        /// Close a point in time prior to its keep alive timeout.
+        void closePointInTime(const std::string& pitId);
+
+        /// Initialize a search_after cursor over a new point in time. Sort defaults to _shard_doc, the cheapest tiebreaker.
+        /// uniqueField is the field unique per document the user sort ends with, required to restart on a new PIT. Returns false on error.
+        bool initSearchAfter(SearchAfterCursor& cursor, const std::string& index, const std::string& query, int pageSize = 1000, const std::string& keepAlive = "1m", const std::string& uniqueField = std::string());
+
+        /// Append the next page of hits to resultArray and move the cursor after the last hit. End is reached when no hit was appended. Returns false on error.
+        /// Throws if the point in time expired or was closed and the cursor cannot restart on a new one.
+        bool searchAfterNext(SearchAfterCursor& cursor, Json::Array& resultArray);
+
+        /// Close the point in time of the cursor, searchAfter is kept to restart later.
+        void clearSearchAfter(SearchAfterCursor& cursor);
 
     private:
         void appendHitsToArray(const Json::Object& msg, Json::Array& resultArray);
 
+        /// Request the document within a batch if batching is enabled and the whole source is requested, on its own otherwise.
+        bool fetchDocument(const char* index, const char* type, const char* id, Json::Object& msg, const std::vector<std::string>& sourceIncludes, const std::vector<std::string>& sourceExcludes);
+
+        /// Send the get request of the document by index/type/id.
+        bool getDocumentById(const char* index, const char* type, const char* id, Json::Object& msg, const std::vector<std::string>& sourceIncludes, const std::vector<std::string>& sourceExcludes);
+
+        /// Invalidate the cached document after a write, result holds the written _version if any.
+        void invalidateDocument(const std::string& index, const std::string& type, const std::string& id, const Json::Object& result);
+
+        /// Invalidate all the cached documents.
+        void invalidateDocuments();
+
+        /// Time left to the request as a timeout url parameter preceded by separator, empty without deadline.
+        std::string timeoutParameter(char separator) const;
+
+        /// Request on the node holding the shard of the document if shard routing is enabled.
+        unsigned int documentRequest(const char* method, const std::string& index, const std::string& id, bool write, const char* endUrl, const char* data, Json::Object* root);
+
+        /// Write request on the document, the cached copy is invalidated once it is sent, even if it throws.
+        unsigned int writeDocument(const char* method, const std::string& index, const std::string& type, const std::string& id, const char* endUrl, const char* data, Json::Object& result);
+
+        /// Write request on many documents, the cache is cleared once it is sent, even if it throws.
+        unsigned int writeDocuments(const char* method, const char* endUrl, const char* data, Json::Object* root);
+
     private:
         /// Private constructor.
         ElasticSearch();
 
-        /// HTTP Connexion module.
-        HTTP _http;
+        /// HTTP Connexion module, pool of connections over the nodes.
+        ConnectionPool _pool;
 
         /// Read Only option, all index functions return false.
         bool _readOnly;
+
+        /// Optional batcher of getDocument/exist by id.
+        std::unique_ptr<MultiGetBatcher> _batcher;
+
+        /// Optional cache of the documents fetched by id.
+        std::unique_ptr<DocumentCache> _cache;
+
+        /// Optional router of the point operations.
+        std::unique_ptr<ShardRouter> _router;
+
+        /// Optional log of the slow operations.
+        std::unique_ptr<SlowQueryLog> _slowLog;
+
+        /// Background sniffer of the nodes.
+        std::thread _sniffer;
+        std::mutex _snifferMutex;
+        std::condition_variable _snifferWakeup;
+        bool _sniffing;
 };
 
 class BulkBuilder {
@@ -127,4 +323,51 @@ class BulkBuilder {
 		bool isEmpty();
 };
 
+/// Packs many searches into one _msearch request, header and body on one line each.
+class MultiSearchBuilder {
+	private:
+		std::vector<std::string> lines;
+
+	public:
+		MultiSearchBuilder();
+		void search(const std::string &index, const std::string &type, const std::string &query);
+		void search(const std::string &index, const std::string &query);
+		void clear();
+		std::string str();
+		bool isEmpty();
+		size_t size();
+};
+
+/// Responses of a _msearch, in the order of the searches.
+/// The raw response is only split in slots, each slot is parsed on first access.
+class MultiSearchResult {
+    public:
+        MultiSearchResult();
+
+        /// Number of responses.
+        size_t size() const { return _slots.size(); }
+
+        /// Response of the i-th search, parsed on first access. Not thread safe.
+        const Json::Object& operator[](size_t i) const;
+
+        /// Raw Json text of the i-th response.
+        std::string raw(size_t i) const;
+
+        /// Split the raw response into slots. Returns false if the response is illformed.
+        bool assign(std::string& raw);
+
+        /// Clear the responses.
+        void clear();
+
+    private:
+        /// Raw response body.
+        std::string _raw;
+
+        /// Offset and size of each response in the raw body.
+        std::vector< std::pair<size_t, size_t> > _slots;
+
+        /// Lazily parsed responses.
+        mutable std::vector< std::unique_ptr<Json::Object> > _parsed;
+};
+
 #endif // ELASTICSEARCH_H
@@ -0,0 +1,282 @@
+#include "routing.h"
+
+#include <sstream>
+#include <cstdlib>
+
+ShardRouter::ShardRouter(ConnectionPool& pool, std::chrono::seconds refresh)
+: _pool(pool), _refresh(refresh), _running(true), _next(0) {
+    _refresher = std::thread(&ShardRouter::refresh, this);
+}
+
+ShardRouter::~ShardRouter() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _refresherWakeup.notify_all();
+
+    if(_refresher.joinable())
+        _refresher.join();
+}
+
+// Murmur3 x86 32 bits hash of the UTF-16 code units of the routing value.
+int32_t ShardRouter::hash(const std::string& routing) {
+
+    // Decode UTF-8 into the little endian bytes of the UTF-16 code units, as Java chars.
+    std::vector<uint8_t> bytes;
+    bytes.reserve(routing.size() * 2);
+
+    for(size_t i = 0; i < routing.size(); ) {
+        uint8_t c = routing[i];
+        uint32_t codePoint;
+        size_t length;
+
+        if(c < 0x80) {
+            codePoint = c;
+            length = 1;
+        } else if((c >> 5) == 0x6) {
+            codePoint = c & 0x1f;
+            length = 2;
+        } else if((c >> 4) == 0xe) {
+            codePoint = c & 0x0f;
+            length = 3;
+        } else {
+            codePoint = c & 0x07;
+            length = 4;
+        }
+
+        for(size_t j = 1; j < length && i + j < routing.size(); ++j)
+            codePoint = (codePoint << 6) | (routing[i + j] & 0x3f);
+        i += length;
+
+        if(codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            uint16_t high = 0xd800 + (codePoint >> 10);
+            uint16_t low = 0xdc00 + (codePoint & 0x3ff);
+            bytes.push_back(high & 0xff);
+            bytes.push_back(high >> 8);
+            bytes.push_back(low & 0xff);
+            bytes.push_back(low >> 8);
+        } else {
+            bytes.push_back(codePoint & 0xff);
+            bytes.push_back(codePoint >> 8);
+        }
+    }
+
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+    uint32_t h = 0;
+    size_t blocks = bytes.size() / 4;
+
+    for(size_t i = 0; i < blocks; ++i) {
+        uint32_t k = bytes[i * 4] | (bytes[i * 4 + 1] << 8) | (bytes[i * 4 + 2] << 16) | ((uint32_t)bytes[i * 4 + 3] << 24);
+        k *= c1;
+        k = (k << 15) | (k >> 17);
+        k *= c2;
+        h ^= k;
+        h = (h << 13) | (h >> 19);
+        h = h * 5 + 0xe6546b64;
+    }
+
+    // The tail is at most one UTF-16 code unit.
+    uint32_t k = 0;
+    size_t tail = blocks * 4;
+    switch(bytes.size() & 3) {
+        case 3:
+            k ^= bytes[tail + 2] << 16;
+            // fall through
+        case 2:
+            k ^= bytes[tail + 1] << 8;
+            // fall through
+        case 1:
+            k ^= bytes[tail];
+            k *= c1;
+            k = (k << 15) | (k >> 17);
+            k *= c2;
+            h ^= k;
+    }
+
+    h ^= bytes.size();
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return (int32_t)h;
+}
+
+// Shard of the routing value.
+int ShardRouter::shardId(const std::string& routing, int routingNumShards, int numberOfShards) {
+    int routingFactor = routingNumShards / numberOfShards;
+
+    // Math.floorMod
+    int shard = hash(routing) % routingNumShards;
+    if(shard < 0)
+        shard += routingNumShards;
+
+    return shard / routingFactor;
+}
+
+// Url of a node holding the shard of the document.
+std::string ShardRouter::node(const std::string& index, const std::string& id, bool write) {
+
+    std::shared_ptr<IndexRouting> routing;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _indices.find(index);
+        if(it != _indices.end()) {
+            routing = it->second;
+
+            // Serve the expired routing, the refresher replaces it.
+            if(routing->loaded + _refresh <= Clock::now() && _stale.insert(index).second)
+                _refresherWakeup.notify_one();
+        }
+        else if(!_loading.insert(index).second) {
+            // Another caller loads it, let the cluster route meanwhile.
+            return std::string();
+        }
+    }
+
+    if(!routing) {
+        routing = load(index);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _indices[index] = routing;
+        _loading.erase(index);
+    }
+
+    if(routing->numberOfShards <= 0)
+        return std::string();
+
+    int shard = shardId(id, routing->routingNumShards, routing->numberOfShards);
+    const std::vector<std::string>& copies = routing->copies[shard];
+
+    if(copies.empty())
+        return std::string();
+
+    if(write)
+        return routing->primaryStarted[shard] ? copies.front() : std::string();
+
+    return copies[_next.fetch_add(1, std::memory_order_relaxed) % copies.size()];
+}
+
+// Reload the expired routings in background.
+void ShardRouter::refresh() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true) {
+        _refresherWakeup.wait(lock, [this]{ return !_running || !_stale.empty(); });
+        if(!_running)
+            return;
+
+        // The index stays queued during the reload so the callers do not queue it again.
+        std::string index = *_stale.begin();
+        lock.unlock();
+        std::shared_ptr<IndexRouting> routing = load(index);
+        lock.lock();
+
+        _indices[index] = routing;
+        _stale.erase(index);
+    }
+}
+
+// Load the http addresses of the nodes by node id.
+bool ShardRouter::loadNodes() {
+    Json::Object msg;
+    if(200 != _pool.get("_nodes/http?filter_path=nodes.*.http.publish_address", 0, &msg) || !msg.member("nodes"))
+        return false;
+
+    std::map<std::string, std::string> addresses;
+    for(Json::Object::const_iterator it = msg["nodes"].getObject().begin(); it != msg["nodes"].getObject().end(); ++it) {
+        const Json::Object& node = it.value().getObject();
+        if(!node.member("http") || !node["http"].getObject().member("publish_address"))
+            continue;
+
+        // The address is published as ip:port or hostname/ip:port.
+        std::string address = node["http"].getObject()["publish_address"].getString();
+        size_t pos = address.find('/');
+        if(pos != std::string::npos)
+            address = address.substr(pos + 1);
+
+        addresses[it.key()] = address;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _addresses.swap(addresses);
+    return true;
+}
+
+// Load the routing of the index from the cluster state.
+std::shared_ptr<ShardRouter::IndexRouting> ShardRouter::load(const std::string& index) {
+
+    std::shared_ptr<IndexRouting> routing = std::make_shared<IndexRouting>();
+    routing->numberOfShards = 0;
+    routing->routingNumShards = 0;
+    routing->loaded = Clock::now();
+
+    try {
+        std::ostringstream oss;
+        oss << "_cluster/state/metadata,routing_table/" << index;
+        oss << "?filter_path=metadata.indices.*.settings.index.number_of_shards,metadata.indices.*.routing_num_shards,routing_table.indices.*.shards";
+
+        Json::Object msg;
+        if(200 != _pool.get(oss.str().c_str(), 0, &msg) || !msg.member("metadata") || !msg.member("routing_table"))
+            return routing;
+
+        // An alias resolves to other indices, leave it to the cluster.
+        const Json::Object& indices = msg["metadata"].getObject()["indices"].getObject();
+        if(!indices.member(index))
+            return routing;
+
+        const Json::Object& metadata = indices[index].getObject();
+        int numberOfShards = metadata["settings"].getObject()["index"].getObject()["number_of_shards"].getInt();
+        int routingNumShards = metadata.member("routing_num_shards") ? metadata["routing_num_shards"].getInt() : numberOfShards;
+
+        if(numberOfShards <= 0 || routingNumShards < numberOfShards)
+            return routing;
+
+        if(!loadNodes())
+            return routing;
+
+        routing->copies.resize(numberOfShards);
+        routing->primaryStarted.assign(numberOfShards, false);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        const Json::Object& shards = msg["routing_table"].getObject()["indices"].getObject()[index].getObject()["shards"].getObject();
+        for(Json::Object::const_iterator it = shards.begin(); it != shards.end(); ++it) {
+            int shard = atoi(it.key().c_str());
+            if(shard < 0 || shard >= numberOfShards)
+                continue;
+
+            for(const Json::Value& value : it.value().getArray()) {
+                const Json::Object& copy = value.getObject();
+                if(!copy.member("node") || copy["node"].isNull() || copy["state"].getString() != "STARTED")
+                    continue;
+
+                auto address = _addresses.find(copy["node"].getString());
+                if(address == _addresses.end())
+                    continue;
+
+                std::vector<std::string>& copies = routing->copies[shard];
+                if(copy["primary"].getBoolean()) {
+                    copies.insert(copies.begin(), address->second);
+                    routing->primaryStarted[shard] = true;
+                } else {
+                    copies.push_back(address->second);
+                }
+            }
+        }
+
+        routing->numberOfShards = numberOfShards;
+        routing->routingNumShards = routingNumShards;
+    }
+    catch(std::exception&) {
+        // Unknown until the next refresh.
+    }
+    catch(Exception&) {
+        // Unknown until the next refresh.
+    }
+
+    return routing;
+}
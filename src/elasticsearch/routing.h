@@ -0,0 +1,90 @@
+#ifndef ROUTING_H
+#define ROUTING_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "http/pool.h"
+
+/// Routes the point operations straight to a node holding the shard of the document.
+/// The shard is computed like Elasticsearch does, murmur3 of the id modulo routing_num_shards,
+/// from the index metadata and routing table of the cluster state, cached and refreshed periodically.
+/// An expired routing is still served while a background thread reloads it.
+class ShardRouter {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        ShardRouter(ConnectionPool& pool, std::chrono::seconds refresh);
+        ~ShardRouter();
+
+        /// Url of a node holding the shard of the document, the primary one for a write. Empty if unknown.
+        std::string node(const std::string& index, const std::string& id, bool write);
+
+        /// Shard of the routing value, as OperationRouting of Elasticsearch.
+        static int shardId(const std::string& routing, int routingNumShards, int numberOfShards);
+
+        /// Murmur3 x86 32 bits hash of the UTF-16 code units of the routing value, as Murmur3HashFunction of Elasticsearch.
+        static int32_t hash(const std::string& routing);
+
+    private:
+        /// Routing of one index.
+        struct IndexRouting {
+            int numberOfShards;
+            int routingNumShards;
+
+            /// Urls of the nodes holding a started copy, primary first, by shard.
+            std::vector< std::vector<std::string> > copies;
+
+            /// Only the primary copies accept writes.
+            std::vector<bool> primaryStarted;
+
+            Clock::time_point loaded;
+        };
+
+        /// Load the routing of the index from the cluster state, null on error.
+        std::shared_ptr<IndexRouting> load(const std::string& index);
+
+        /// Load the http addresses of the nodes by node id.
+        bool loadNodes();
+
+        /// Reload the expired routings in background until the router is destroyed.
+        void refresh();
+
+        ConnectionPool& _pool;
+
+        /// Time before reloading the routing of an index.
+        std::chrono::seconds _refresh;
+
+        /// Routing by index, an empty routing means the index is unknown until the next refresh.
+        std::map< std::string, std::shared_ptr<IndexRouting> > _indices;
+
+        /// Node http address by node id.
+        std::map< std::string, std::string > _addresses;
+
+        /// Indices loaded for the first time by a caller, the other callers do not wait for it.
+        std::set<std::string> _loading;
+
+        /// Expired indices queued to the refresher, one reload at a time for each.
+        std::set<std::string> _stale;
+
+        std::mutex _mutex;
+
+        /// Background reload of the expired routings.
+        std::thread _refresher;
+        std::condition_variable _refresherWakeup;
+        bool _running;
+
+        /// Spreads the reads over the copies.
+        std::atomic<size_t> _next;
+};
+
+#endif // ROUTING_H
@@ -0,0 +1,136 @@
+#include "slowlog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <thread>
+
+// Copy the string, truncated to the buffer.
+static void copyTruncated(char* buffer, size_t bufferSize, const char* data, size_t size) {
+    size = std::min(size, bufferSize - 1);
+    memcpy(buffer, data, size);
+    buffer[size] = '\0';
+}
+
+// One line of text.
+std::string SlowQueryLog::Entry::str() const {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    std::tm utc;
+    gmtime_r(&seconds, &utc);
+
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+    std::ostringstream oss;
+    oss << date << " " << endpoint << " status " << statusCode << (failed ? " failed" : "")
+        << " took " << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() << "us";
+
+    for(int phase = 0; phase < Instrumentation::TOTAL; ++phase)
+        oss << " " << Instrumentation::name(static_cast<Instrumentation::Phase>(phase)) << " " << phases[phase] / 1000 << "us";
+
+    oss << " response " << responseSize << "B body " << bodySize << "B ";
+
+    // The line breaks of the bulks are escaped, one entry stays on one line.
+    for(const char* c = body; *c; ++c) {
+        if(*c == '\n')
+            oss << "\\n";
+        else if(*c == '\r')
+            oss << "\\r";
+        else
+            oss << *c;
+    }
+
+    if(bodySize >= BodySize)
+        oss << "...";
+
+    return oss.str();
+}
+
+SlowQueryLog::SlowQueryLog(size_t capacity, std::chrono::milliseconds threshold)
+: _slots(new Slot[std::max<size_t>(capacity, 1)]),
+  _capacity(std::max<size_t>(capacity, 1)),
+  _threshold(threshold),
+  _next(0),
+  _dropped(0)
+{
+}
+
+// Record an operation in the next slot, dropped if the slot is busy.
+void SlowQueryLog::record(const char* method, const std::string& endUrl, const char* body, unsigned int statusCode, bool failed,
+                          Clock::duration duration, uint64_t sequence) {
+
+    uint64_t position = _next.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = _slots[position % _capacity];
+
+    if(slot.busy.exchange(true, std::memory_order_acquire)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Entry& entry = slot.entry;
+    entry.time = std::chrono::system_clock::now();
+
+    int length = snprintf(entry.endpoint, EndpointSize, "%s %s", method, endUrl.c_str());
+    if(length < 0)
+        entry.endpoint[0] = '\0';
+
+    entry.bodySize = body ? strlen(body) : 0;
+    copyTruncated(entry.body, BodySize, body ? body : "", entry.bodySize);
+
+    entry.statusCode = statusCode;
+    entry.failed = failed;
+    entry.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+
+    // The last request of the thread belongs to the operation only if it ended after the operation started.
+    const Instrumentation::Request& request = Instrumentation::lastRequest();
+    if(request.sequence != sequence) {
+        std::copy(request.phases, request.phases + Instrumentation::PhaseCount, entry.phases);
+        entry.responseSize = request.received;
+    }
+    else {
+        std::fill(entry.phases, entry.phases + Instrumentation::PhaseCount, 0);
+        entry.responseSize = 0;
+    }
+
+    slot.sequence = position + 1;
+    slot.busy.store(false, std::memory_order_release);
+}
+
+// Entries recorded so far, oldest first, the dump waits for the writers of the slots.
+std::vector<SlowQueryLog::Entry> SlowQueryLog::entries() const {
+    std::vector< std::pair<uint64_t, size_t> > order;
+    std::vector<Entry> entries;
+    entries.reserve(_capacity);
+
+    for(size_t i = 0; i < _capacity; ++i) {
+        Slot& slot = _slots[i];
+        while(slot.busy.exchange(true, std::memory_order_acquire))
+            std::this_thread::yield();
+
+        if(slot.sequence != 0) {
+            order.push_back(std::make_pair(slot.sequence, entries.size()));
+            entries.push_back(slot.entry);
+        }
+
+        slot.busy.store(false, std::memory_order_release);
+    }
+
+    std::sort(order.begin(), order.end());
+
+    std::vector<Entry> sorted;
+    sorted.reserve(entries.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        sorted.push_back(entries[order[i].second]);
+
+    return sorted;
+}
+
+// Entries as text, one line each.
+std::string SlowQueryLog::str() const {
+    std::string text;
+    for(const Entry& entry : entries())
+        text += entry.str() + "\n";
+    return text;
+}
@@ -0,0 +1,92 @@
+#ifndef SLOWLOG_H
+#define SLOWLOG_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "http/instrumentation.h"
+
+/// Fixed ring of the last requests slower than a threshold, or failed, dumped on demand.
+/// Recording never blocks nor allocates: the slot is claimed with an atomic counter, and a slot still
+/// busy with another writer or a dump is skipped and counted as dropped.
+class SlowQueryLog {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        /// Longest endpoint and request body kept, the longer ones are truncated.
+        static const size_t EndpointSize = 256;
+        static const size_t BodySize = 1024;
+
+        /// One recorded request.
+        struct Entry {
+            /// Wall clock time of the end of the request.
+            std::chrono::system_clock::time_point time;
+
+            /// Method and end of the url, truncated.
+            char endpoint[EndpointSize];
+
+            /// Start of the request body, and its whole size.
+            char body[BodySize];
+            size_t bodySize;
+
+            /// Status code of the response, 0 if none, and whether the operation failed.
+            unsigned int statusCode;
+            bool failed;
+
+            /// Duration of the operation, retries included.
+            std::chrono::nanoseconds duration;
+
+            /// Durations of the phases of the last attempt in nanoseconds, and the bytes received for it.
+            /// Zero if the request was not sent or the instrumentation is compiled out.
+            uint64_t phases[Instrumentation::PhaseCount];
+            uint64_t responseSize;
+
+            /// One line of text.
+            std::string str() const;
+        };
+
+        /// Keep the last capacity requests slower than threshold.
+        SlowQueryLog(size_t capacity, std::chrono::milliseconds threshold);
+
+        /// Tells if an operation of this duration is recorded.
+        inline bool slow(Clock::duration duration) const { return duration >= _threshold; }
+
+        /// Record an operation, with the phases of the last request of the thread if it was sent since sequence.
+        void record(const char* method, const std::string& endUrl, const char* body, unsigned int statusCode, bool failed,
+                    Clock::duration duration, uint64_t sequence);
+
+        /// Entries recorded so far, oldest first.
+        std::vector<Entry> entries() const;
+
+        /// Entries as text, one line each.
+        std::string str() const;
+
+        /// Entries lost because their slot was busy.
+        inline uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    private:
+        struct Slot {
+            Slot() : busy(false), sequence(0) {}
+
+            /// Held by the writer or the dump.
+            std::atomic<bool> busy;
+
+            /// Position of the entry in the log plus one, 0 while the slot is empty.
+            uint64_t sequence;
+            Entry entry;
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        size_t _capacity;
+        Clock::duration _threshold;
+
+        /// Next position in the log.
+        std::atomic<uint64_t> _next;
+        std::atomic<uint64_t> _dropped;
+};
+
+#endif // SLOWLOG_H
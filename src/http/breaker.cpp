@@ -0,0 +1,152 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "breaker.h"
+
+CircuitBreaker::CircuitBreaker()
+: _enabled(false),
+  _state(CLOSED),
+  _openUntil(0),
+  _probing(false),
+  _calls(0),
+  _failures(0),
+  _slowCalls(0)
+{
+}
+
+// Enable the breaker with the settings, or disable it.
+void CircuitBreaker::configure(bool enabled, const Settings& settings) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _enabled.store(enabled, std::memory_order_relaxed);
+    _settings = settings;
+    _state.store(CLOSED, std::memory_order_relaxed);
+    _probing.store(false, std::memory_order_relaxed);
+    reset(Clock::now());
+}
+
+// Tells if a request may be sent now.
+bool CircuitBreaker::available(Clock::time_point now) const {
+    switch(state()) {
+        case CLOSED:
+            return true;
+
+        case OPEN:
+            return _openUntil.load(std::memory_order_relaxed) <= now.time_since_epoch().count();
+
+        case HALF_OPEN:
+            return !_probing.load(std::memory_order_relaxed);
+    }
+
+    return true;
+}
+
+// Take the right to send a request.
+bool CircuitBreaker::allow() {
+    if(!_enabled.load(std::memory_order_relaxed) || state() == CLOSED)
+        return true;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(state() == OPEN) {
+        if(_openUntil.load(std::memory_order_relaxed) > Clock::now().time_since_epoch().count())
+            return false;
+
+        _state.store(HALF_OPEN, std::memory_order_relaxed);
+    }
+
+    if(state() == HALF_OPEN) {
+        if(_probing.load(std::memory_order_relaxed))
+            return false;
+
+        _probing.store(true, std::memory_order_relaxed);
+    }
+
+    return true;
+}
+
+// Account the outcome of an allowed request.
+void CircuitBreaker::record(bool success, std::chrono::microseconds latency) {
+    if(!_enabled.load(std::memory_order_relaxed))
+        return;
+
+    Clock::time_point now = Clock::now();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // A concurrent configure may have disabled the breaker since.
+    if(!_enabled.load(std::memory_order_relaxed))
+        return;
+
+    bool slow = (latency >= _settings.slowCall);
+
+    switch(state()) {
+        case HALF_OPEN:
+            _probing.store(false, std::memory_order_relaxed);
+            if(success && !slow) {
+                _state.store(CLOSED, std::memory_order_relaxed);
+                reset(now);
+            } else
+                open(now);
+            return;
+
+        // Requests sent before the breaker opened.
+        case OPEN:
+            return;
+
+        case CLOSED:
+            break;
+    }
+
+    if(now - _windowStart >= _settings.window)
+        reset(now);
+
+    ++_calls;
+    if(!success)
+        ++_failures;
+    if(slow)
+        ++_slowCalls;
+
+    if(_calls < _settings.minCalls)
+        return;
+
+    if(_failures >= _settings.failureRate * _calls || _slowCalls >= _settings.slowCallRate * _calls)
+        open(now);
+}
+
+// Forget an allowed request that was cancelled.
+void CircuitBreaker::cancel() {
+    if(_enabled.load(std::memory_order_relaxed) && state() == HALF_OPEN)
+        _probing.store(false, std::memory_order_relaxed);
+}
+
+// Open the breaker for the open time.
+void CircuitBreaker::open(Clock::time_point now) {
+    _openUntil.store((now + _settings.openTime).time_since_epoch().count(), std::memory_order_relaxed);
+    _state.store(OPEN, std::memory_order_relaxed);
+}
+
+// Start a new window.
+void CircuitBreaker::reset(Clock::time_point now) {
+    _windowStart = now;
+    _calls = 0;
+    _failures = 0;
+    _slowCalls = 0;
+}
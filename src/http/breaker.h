@@ -0,0 +1,111 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef BREAKER_H
+#define BREAKER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+/// Circuit breaker of a node. It opens when too many requests of the current window failed or were slow,
+/// then rejects the requests for the open time. A single probe request is let through after (half open),
+/// its success closes the breaker, its failure opens it again.
+class CircuitBreaker {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Settings {
+            Settings() : failureRate(0.5), slowCallRate(0.5), slowCall(2000), minCalls(20), window(10000), openTime(5000) {}
+
+            /// Ratio of failed requests (no answer, 429 or 5xx) that opens the breaker.
+            double failureRate;
+
+            /// Ratio of slow requests that opens the breaker.
+            double slowCallRate;
+
+            /// Latency from which a request is slow.
+            std::chrono::milliseconds slowCall;
+
+            /// Requests in the window before the ratios are considered.
+            unsigned int minCalls;
+
+            /// Duration of the window of the ratios.
+            std::chrono::milliseconds window;
+
+            /// Time the breaker stays open before the probe.
+            std::chrono::milliseconds openTime;
+        };
+
+        enum State {
+            CLOSED,
+            OPEN,
+            HALF_OPEN
+        };
+
+        CircuitBreaker();
+
+        /// Enable the breaker with the settings, or disable it. Requests in flight may be accounted with either settings.
+        void configure(bool enabled, const Settings& settings);
+
+        /// Tells if a request may be sent now, without taking the probe of a half open breaker.
+        bool available(Clock::time_point now) const;
+
+        /// Take the right to send a request, the probe if half open. False if the request must not be sent.
+        bool allow();
+
+        /// Account the outcome of an allowed request.
+        void record(bool success, std::chrono::microseconds latency);
+
+        /// Forget an allowed request that was cancelled, it says nothing about the node.
+        void cancel();
+
+        /// Current state.
+        inline State state() const { return static_cast<State>(_state.load(std::memory_order_relaxed)); }
+
+    private:
+        /// Open the breaker for the open time.
+        void open(Clock::time_point now);
+
+        /// Start a new window.
+        void reset(Clock::time_point now);
+
+        std::atomic<bool> _enabled;
+
+        /// Read and written under the mutex.
+        Settings _settings;
+
+        std::atomic<int> _state;
+
+        /// End of the open time since the clock epoch.
+        std::atomic<Clock::rep> _openUntil;
+
+        /// A probe is in flight while half open.
+        std::atomic<bool> _probing;
+
+        /// Counters of the current window.
+        std::mutex _mutex;
+        Clock::time_point _windowStart;
+        unsigned int _calls;
+        unsigned int _failures;
+        unsigned int _slowCalls;
+};
+
+#endif // BREAKER_H
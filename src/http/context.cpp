@@ -0,0 +1,157 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "context.h"
+#include "http.h"
+
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+
+/// Pipe kept by a thread for the tokens created on it, one at a time.
+struct ThreadPipe {
+    ThreadPipe() : inUse(false) {
+        if(pipe(fds) != 0)
+            fds[0] = fds[1] = -1;
+
+        for(int fd : fds) {
+            if(fd >= 0)
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+    }
+
+    ~ThreadPipe() {
+        for(int fd : fds) {
+            if(fd >= 0)
+                close(fd);
+        }
+    }
+
+    int fds[2];
+    bool inUse;
+};
+
+static thread_local ThreadPipe threadPipe;
+
+CancellationToken::CancellationToken(const CancellationToken* parent, Pipe pipe)
+: _parent(parent),
+  _cancelled(false),
+  _threadPipe(false)
+{
+    // Borrow the pipe of the thread if free, a second token of the thread gets its own.
+    if(pipe == THREAD_PIPE && !threadPipe.inUse && threadPipe.fds[0] >= 0) {
+        threadPipe.inUse = true;
+        _pipe[0] = threadPipe.fds[0];
+        _pipe[1] = threadPipe.fds[1];
+        _threadPipe = true;
+        return;
+    }
+
+    if(::pipe(_pipe) != 0)
+        EXCEPTION("Cannot create the cancellation pipe.");
+
+    fcntl(_pipe[0], F_SETFL, fcntl(_pipe[0], F_GETFL, 0) | O_NONBLOCK);
+    fcntl(_pipe[1], F_SETFL, fcntl(_pipe[1], F_GETFL, 0) | O_NONBLOCK);
+}
+
+CancellationToken::~CancellationToken() {
+    if(_threadPipe) {
+        // The next token of the thread starts with an empty pipe.
+        char buffer[16];
+        if(_cancelled.load(std::memory_order_acquire))
+            while(::read(_pipe[0], buffer, sizeof(buffer)) > 0);
+
+        threadPipe.inUse = false;
+        return;
+    }
+
+    close(_pipe[0]);
+    close(_pipe[1]);
+}
+
+// Abort the requests using this token.
+void CancellationToken::cancel() {
+    if(_cancelled.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    // The byte is never read, the pipe stays readable.
+    char byte = 1;
+    if(::write(_pipe[1], &byte, 1) < 0)
+        errno = 0;
+}
+
+RequestContext::RequestContext()
+: _deadline(Clock::time_point::max()),
+  _token(0)
+{
+}
+
+// Context of the current thread.
+RequestContext& RequestContext::current() {
+    static thread_local RequestContext context;
+    return context;
+}
+
+// Time left before the deadline, at most limit.
+std::chrono::milliseconds RequestContext::remaining(std::chrono::milliseconds limit) const {
+    if(!hasDeadline())
+        return limit;
+
+    Clock::time_point now = Clock::now();
+    if(now >= _deadline)
+        return std::chrono::milliseconds(0);
+
+    // Round up so a positive time left never becomes zero.
+    std::chrono::milliseconds left = std::chrono::duration_cast<std::chrono::milliseconds>(_deadline - now + std::chrono::microseconds(999));
+    return std::min(left, limit);
+}
+
+RequestContext::Scope::Scope(std::chrono::milliseconds timeout, CancellationToken* token)
+: _context(current()),
+  _previousDeadline(_context._deadline),
+  _previousToken(_context._token)
+{
+    _context._deadline = std::min(_previousDeadline, Clock::now() + timeout);
+    if(token)
+        _context._token = token;
+}
+
+RequestContext::Scope::Scope(Clock::time_point deadline, CancellationToken* token)
+: _context(current()),
+  _previousDeadline(_context._deadline),
+  _previousToken(_context._token)
+{
+    _context._deadline = std::min(_previousDeadline, deadline);
+    if(token)
+        _context._token = token;
+}
+
+RequestContext::Scope::Scope(CancellationToken& token)
+: _context(current()),
+  _previousDeadline(_context._deadline),
+  _previousToken(_context._token)
+{
+    _context._token = &token;
+}
+
+RequestContext::Scope::~Scope() {
+    _context._deadline = _previousDeadline;
+    _context._token = _previousToken;
+}
@@ -0,0 +1,120 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <atomic>
+#include <chrono>
+
+/// Cancellation shared between a caller and the requests it runs, cancel() aborts the requests in flight.
+/// A token is also cancelled with its parent. The token must outlive the requests using it.
+class CancellationToken {
+    public:
+        /// Pipe of the token: its own, or one kept by the current thread for its lifetime. A token on the thread
+        /// pipe costs no system call unless cancelled, but must only be used by the thread that created it.
+        enum Pipe { OWN_PIPE, THREAD_PIPE };
+
+        explicit CancellationToken(const CancellationToken* parent = 0, Pipe pipe = OWN_PIPE);
+        ~CancellationToken();
+
+        /// Abort the requests using this token, may be called from any thread.
+        void cancel();
+
+        /// Tells if cancel() was called on this token or a parent.
+        inline bool cancelled() const { return _cancelled.load(std::memory_order_acquire) || (_parent && _parent->cancelled()); }
+
+        /// Descriptor readable once this token is cancelled, so select wakes up. The parents have their own.
+        inline int fd() const { return _pipe[0]; }
+
+        /// Parent token, null if none.
+        inline const CancellationToken* parent() const { return _parent; }
+
+    private:
+        CancellationToken(const CancellationToken&);
+        CancellationToken& operator=(const CancellationToken&);
+
+        const CancellationToken* _parent;
+        std::atomic<bool> _cancelled;
+        int _pipe[2];
+
+        /// The pipe is the one of the thread, drained instead of closed.
+        bool _threadPipe;
+};
+
+/// Deadline and cancellation token of the requests run by the current thread.
+/// A Scope installs them for its lifetime, so any ElasticSearch call may be given a deadline:
+///
+///     RequestContext::Scope scope(std::chrono::milliseconds(200), &token);
+///     es.search(...);
+class RequestContext {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        /// Install a deadline and a token on the current thread until destruction. Nested scopes keep
+        /// the earliest deadline and inherit the token if none is given.
+        class Scope {
+            public:
+                Scope(std::chrono::milliseconds timeout, CancellationToken* token = 0);
+                Scope(Clock::time_point deadline, CancellationToken* token = 0);
+                explicit Scope(CancellationToken& token);
+                ~Scope();
+
+            private:
+                Scope(const Scope&);
+                Scope& operator=(const Scope&);
+
+                RequestContext& _context;
+                Clock::time_point _previousDeadline;
+                CancellationToken* _previousToken;
+        };
+
+        RequestContext();
+
+        /// Context of the current thread.
+        static RequestContext& current();
+
+        /// Tells if a deadline is set.
+        inline bool hasDeadline() const { return _deadline != Clock::time_point::max(); }
+
+        /// Deadline, time_point::max() if none.
+        inline Clock::time_point deadline() const { return _deadline; }
+
+        /// Time left before the deadline, at most limit.
+        std::chrono::milliseconds remaining(std::chrono::milliseconds limit) const;
+
+        /// Tells if the deadline is over.
+        inline bool expired() const { return hasDeadline() && Clock::now() >= _deadline; }
+
+        /// Cancellation token, null if none.
+        inline CancellationToken* token() const { return _token; }
+
+        /// Tells if the token was cancelled.
+        inline bool cancelled() const { return _token && _token->cancelled(); }
+
+        /// Tells if the requests must stop, cancelled or over the deadline.
+        inline bool aborted() const { return cancelled() || expired(); }
+
+    private:
+        Clock::time_point _deadline;
+        CancellationToken* _token;
+};
+
+#endif // CONTEXT_H
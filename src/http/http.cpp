@@ -19,21 +19,38 @@
 
 
 #include "http.h"
+#include "resolver.h"
+#include "response.h"
+#include "context.h"
+#include "instrumentation.h"
+#include "metrics.h"
 
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
 #include <iostream>
-#include <netdb.h>
 #include <unistd.h>
 #include <cassert>
 #include <fcntl.h>
-#include <arpa/inet.h>
 #include <sys/types.h>
 #include <algorithm>
+#include <zlib.h>
+#include <netinet/tcp.h>
 
 #include <fcntl.h>
 
+/// Size of the pieces of a large body sent as chunks.
+#define CHUNK_SIZE 1024
+
+/// Size of the pieces of a compressed body sent as chunks.
+#define DEFLATE_CHUNK_SIZE 16384
+
+/// Size of the socket reads.
+#define READ_BUFFER_SIZE 16384
+
+/// Size from which the coalesced header and chunks are written.
+#define WRITE_BUFFER_SIZE 65536
+
 /** Returns true on success, or false if there was an error */
 bool SetSocketBlockingEnabled(int fd, bool blocking) {
    if (fd < 0) return false;
@@ -48,6 +65,40 @@ bool SetSocketBlockingEnabled(int fd, bool blocking) {
    return (fcntl(fd, F_SETFL, flags) == 0) ? true : false;
 }
 
+// Throw if the request of the current thread is cancelled or over its deadline.
+static void throwIfAborted(const RequestContext& context) {
+    if(context.cancelled())
+        EXCEPTION("Request cancelled.");
+
+    if(context.expired())
+        EXCEPTION("Request deadline exceeded.");
+}
+
+/// Report the start and the completion of a request to the trace hook, nothing without hook.
+class TraceScope {
+    public:
+        TraceScope(TraceHook* hook, TraceRequest& request, const char* method, const char* endUrl, const std::string& node)
+        : _hook(hook), _request(request) {
+            if(!_hook)
+                return;
+
+            _request.reset(method, endUrl, node);
+            _hook->onRequestStart(_request);
+        }
+
+        ~TraceScope() {
+            if(!_hook)
+                return;
+
+            _request.total = TraceRequest::Clock::now() - _request.start;
+            _hook->onComplete(_request);
+        }
+
+    private:
+        TraceHook* _hook;
+        TraceRequest& _request;
+};
+
 int to_int(const std::string& str){
     int numb;
     std::istringstream ( str ) >> numb;
@@ -55,11 +106,12 @@ int to_int(const std::string& str){
 }
 
 HTTP::HTTP(std::string uri, bool keepAlive)
-: _connection(0),
-  _sockfd(-1),
+: _sockfd(-1),
   _keepAlive(keepAlive),
-  _keepAliveTimeout(60),
-  _lastRequest(0)
+  _lastRequest(0),
+  _closedByPeer(false),
+  _compressionThreshold(0),
+  _acceptEncoding(false)
 {
     // Remove http protocol if set.
     size_t pos = uri.find("http://");
@@ -79,8 +131,12 @@ HTTP::HTTP(std::string uri, bool keepAlive)
     //std::cout << "_urn " << _urn << std::endl;
     //std::cout << "_url " << _url << std::endl;
 
-    // Extract the port if it's in the domain name.
-    pos = _url.find(":");
+    // Extract the port if it's in the domain name, an IPv6 address is in brackets.
+    size_t endHost = 0;
+    if(!_url.empty() && _url[0] == '[')
+        endHost = _url.find("]");
+
+    pos = _url.find(":", endHost == std::string::npos ? 0 : endHost);
     if(pos != std::string::npos){
         _port = to_int(_url.substr(pos + 1));
         _url = _url.substr(0, pos);
@@ -88,87 +144,109 @@ HTTP::HTTP(std::string uri, bool keepAlive)
         _port = 80;
     }
 
-    struct hostent* host = gethostbyname(_url.c_str());
+    _host = _url;
+    if(_host.size() > 2 && _host[0] == '[' && _host[_host.size() - 1] == ']')
+        _host = _host.substr(1, _host.size() - 2);
+
+    // Resolve in background, the first connection waits for it.
+    Resolver::instance().prefetch(_host, _port);
+}
 
-    if ( (host == NULL) || (host->h_addr == NULL) )
-        EXCEPTION("Error retrieving DNS information.");
+HTTP::~HTTP() {
+    // Set the socket free.
+    disconnect();
+}
 
-    // print information about this host:
-    struct in_addr **addr_list;
-    printf("Official name is: %s", host->h_name);
-    printf(", IP addresses: ");
-    addr_list = (struct in_addr **)host->h_addr_list;
-    for(int i = 0; addr_list[i] != NULL; i++)
-        printf("%s ", inet_ntoa(*addr_list[i]));
+// Timeouts of the next requests.
+void HTTP::setTimeouts(const Timeouts& timeouts) {
+    _timeouts = timeouts;
+}
 
-    if(_keepAlive)
-        printf(", session keep alive connection.\n");
-    else
-        printf(", session is not keep alive connection.\n");
+// Options of the next connections.
+void HTTP::setSocketOptions(const SocketOptions& options) {
+    _socketOptions = options;
+}
 
-    bzero(&_client, sizeof(_client));
+// Counters of the connection and its requests.
+void HTTP::setMetrics(const std::shared_ptr<HTTPMetrics>& metrics) {
+    if(_metrics != metrics)
+        _metrics = metrics;
+}
 
-    _client.sin_family = AF_INET;
-    _client.sin_port = htons( _port );
-    memcpy(&_client.sin_addr, host->h_addr, host->h_length);
+// Hook following every request.
+void HTTP::setTraceHook(const std::shared_ptr<TraceHook>& hook) {
+    if(_traceHook != hook)
+        _traceHook = hook;
 }
 
-HTTP::~HTTP() {
-    // Set the socket free.
-    disconnect();
+// Compress the request bodies from the given size, 0 to disable, and accept compressed responses.
+void HTTP::setCompression(size_t threshold, bool acceptEncoding) {
+    _compressionThreshold = threshold;
+    _acceptEncoding = acceptEncoding;
 }
 
 
-// Returns true if managed to connect.
+// Returns true if managed to connect, the retries are left to the caller.
 bool HTTP::connect(){
 
-    if( ++_connection > 5 )
-        return false;
+    // Spread the connections over the addresses of the host, try the next one on failure.
+    Resolver::Resolution resolution = Resolver::instance().resolve(_host, _port);
+    size_t size = resolution.addresses->size();
+
+    for(size_t i = 0; i < size; ++i) {
+        const Address& address = (*resolution.addresses)[(resolution.next + i) % size];
+        try {
+            return connect(address);
+        }
+        catch(Exception&) {
+            if(i + 1 == size || RequestContext::current().aborted())
+                throw;
+        }
+    }
+
+    return false;
+}
+
+// Connect to one address of the host.
+bool HTTP::connect(const Address& address){
 
     // If socket point already present. Close connection.
-    if(_sockfd >= 0)
-        close(_sockfd);
+    disconnect();
 
     /* Create a socket point */
-    _sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    _sockfd = socket(address.storage.ss_family, SOCK_STREAM, 0);
 
     if (_sockfd < 0)
         EXCEPTION("Error creating socket.");
 
+    // Buffer sizes must be set before connecting, the window scale is negotiated then.
+    applySocketOptions();
+
     // Set socket non-bloking
     int flags = fcntl(_sockfd, F_GETFL, 0);
     fcntl(_sockfd, F_SETFL, flags | O_NONBLOCK);
 
     /* Now connect to the server */
-    int n = ::connect(_sockfd, (struct sockaddr*)&_client, sizeof(_client));
-    if( n < 0 && errno != EINPROGRESS)
+    int n = ::connect(_sockfd, (const struct sockaddr*)&address.storage, address.length);
+    if( n < 0 && errno != EINPROGRESS) {
+        disconnect();
+        errno = 0;
         EXCEPTION("Failed to connect to host.");
+    }
 
-    assert(errno == EINPROGRESS);
+    assert(n == 0 || errno == EINPROGRESS);
     errno = 0;
 
-    if(n == 0){
-        _connection = 0;
+    if(n == 0)
         return true;
-    }
-
-    fd_set			rset, wset;
-    struct timeval	tval;
-
-    FD_ZERO(&rset);
 
-    FD_SET(_sockfd, &rset);
-    wset = rset;
-    tval.tv_sec = 5;
-    tval.tv_usec = 0;
-
-    if ( (n = select(_sockfd+1, &rset, &wset, NULL, &tval)) == 0) {
-        close(_sockfd);		/* timeout */
-        errno = ETIMEDOUT;
-        EXCEPTION("Failed to connect to host.");
+    if ( (n = wait(true, _timeouts.connect)) == 0) {
+        disconnect();		/* timeout */
+        errno = 0;
+        EXCEPTION("Failed to connect to host, timeout.");
     }
 
-    if (FD_ISSET(_sockfd, &rset) || FD_ISSET(_sockfd, &wset)) {
+    if (n > 0) {
         int errorValue;
         socklen_t len = sizeof(errorValue);
         if (getsockopt(_sockfd, SOL_SOCKET, SO_ERROR, &errorValue, &len) < 0)
@@ -176,27 +254,132 @@ bool HTTP::connect(){
 
         errno = errorValue;
         if(error()) {
-            close(_sockfd);		/* just in case */
+            disconnect();		/* just in case */
             EXCEPTION("error set by getsockopt.");
         }
     } else
         EXCEPTION("select error: sockfd not set");
 
     if(error()) {
-        close(_sockfd);		/* just in case */
+        disconnect();		/* just in case */
         EXCEPTION("error set by select.");
     }
 
-    _connection = 0;
-
     return true;
 }
 
+// Wait until the socket is ready within the timeout and the deadline of the request, a cancellation wakes it up.
+int HTTP::wait(bool forWrite, std::chrono::milliseconds timeout) {
+
+    const RequestContext& context = RequestContext::current();
+    CancellationToken* token = context.token();
+
+    fd_set readSet, writeSet, errorSet;
+
+    FD_ZERO( &readSet);
+    FD_ZERO( &writeSet);
+    FD_ZERO( &errorSet);
+    FD_SET( _sockfd, forWrite ? &writeSet : &readSet);
+    FD_SET( _sockfd, &errorSet);
+
+    int maxFd = _sockfd;
+    for(const CancellationToken* t = token; t != 0; t = t->parent()) {
+        FD_SET( t->fd(), &readSet);
+        maxFd = std::max(maxFd, t->fd());
+    }
+
+    std::chrono::milliseconds left = context.remaining(timeout);
+
+    // Time value before timeout.
+    timeval tval;
+    tval.tv_sec = left.count() / 1000;
+    tval.tv_usec = (left.count() % 1000) * 1000;
+
+    int ret = select( maxFd + 1, &readSet, &writeSet, &errorSet, &tval );
+
+    if(context.aborted()) {
+        disconnect();
+        errno = 0;
+        throwIfAborted(context);
+    }
+
+    // Is error ?
+    if(ret < 0) {
+        error();
+        return -1;
+    }
+
+    // Is timeout ?
+    if(ret == 0)
+        return 0;
+
+    // Check error on socket
+    if(FD_ISSET( _sockfd, &errorSet)) {
+        error();
+        return -1;
+    }
+
+    return 1;
+}
+
+// Apply the socket options to the new socket, the options not supported by the system are ignored.
+void HTTP::applySocketOptions() {
+    int value;
+
+    if(_socketOptions.noDelay) {
+        value = 1;
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    }
+
+    if(_socketOptions.receiveBuffer > 0)
+        setsockopt(_sockfd, SOL_SOCKET, SO_RCVBUF, &_socketOptions.receiveBuffer, sizeof(_socketOptions.receiveBuffer));
+
+    if(_socketOptions.sendBuffer > 0)
+        setsockopt(_sockfd, SOL_SOCKET, SO_SNDBUF, &_socketOptions.sendBuffer, sizeof(_socketOptions.sendBuffer));
+
+    if(_socketOptions.keepAlive) {
+        value = 1;
+        setsockopt(_sockfd, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(value));
+
+        #ifdef TCP_KEEPIDLE
+        value = _socketOptions.keepAliveIdle.count();
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_KEEPIDLE, &value, sizeof(value));
+        #elif defined(TCP_KEEPALIVE)
+        value = _socketOptions.keepAliveIdle.count();
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_KEEPALIVE, &value, sizeof(value));
+        #endif
+
+        #ifdef TCP_KEEPINTVL
+        value = _socketOptions.keepAliveInterval.count();
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_KEEPINTVL, &value, sizeof(value));
+        #endif
+
+        #ifdef TCP_KEEPCNT
+        value = _socketOptions.keepAliveCount;
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_KEEPCNT, &value, sizeof(value));
+        #endif
+    }
+
+    #ifdef TCP_QUICKACK
+    if(_socketOptions.quickAck) {
+        value = 1;
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
+    }
+    #endif
+
+    // Failures are not errors of the connection.
+    errno = 0;
+}
+
 void HTTP::disconnect() {
 
-    if(_sockfd >= 0)
+    if(_sockfd >= 0) {
         close(_sockfd);
 
+        if(_metrics)
+            _metrics->connectionClosed();
+    }
+
     _sockfd = -1;
 
 }
@@ -213,18 +396,18 @@ bool HTTP::error() {
 
     // Socket is already connected
     if( errno == EISCONN )
-        printf("Socket is already connected\n");
+        ES_LOG(WARNING, "Socket is already connected.");
 
     if(errno == EINVAL )
-        printf("Exception caught while reading socket - Invalid argument: _sfd = %i\n", _sockfd);
+        ES_LOG(WARNING, "Invalid argument on socket " << _sockfd << ".");
 
     if( errno == ECONNREFUSED )
-        printf("Couldn't connect, connection refused.\n");
+        ES_LOG(WARNING, "Couldn't connect to " << _host << ":" << _port << ", connection refused.");
 
     if( errno == EINPROGRESS )
-        printf("This returns is often see for large ElasticSearch requests.\n");
+        ES_LOG(WARNING, "This returns is often see for large ElasticSearch requests.");
 
-    printf("Exception caught while reading socket - %s.\n",strerror(errno));
+    ES_LOG(WARNING, "Error on the socket of " << _host << ":" << _port << " - " << strerror(errno) << ".");
 
     // reset errno
     errno = 0;
@@ -242,36 +425,32 @@ bool HTTP::request(const char* method, const char* endUrl, const char* data, Jso
 // Get Json Object on web server.
 unsigned int HTTP::request(const char* method, const char* endUrl, const char* data, Json::Object* jOutput, Result& result, const char* content_type){
 
+    ES_INSTRUMENT_REQUEST(method, endUrl);
+
     unsigned int statusCode = 0;
 
     std::string output;
     statusCode = request(method, endUrl, data, output, result, content_type);
-    if(result != OK) {
-
-        // Give a second chance.
-        disconnect();
-
-        statusCode = request(method, endUrl, data, output, result, content_type);
-        if(result != OK)
-            return statusCode;
-    }
+    if(result != OK)
+        return statusCode;
 
     try {
         if (jOutput && output.size()) {
+            ES_INSTRUMENT_PHASE(PARSE);
             jOutput->addMember(output.c_str(), output.c_str() + output.size());
         }
     }
     catch(Exception& e){
-        printf("parser() failed in Getter. Exception caught: %s\n", e.what());
+        ES_LOG(ERROR, "parser() failed in Getter. Exception caught: " << e.what());
         result = ERROR;
         return statusCode;
     }
     catch(std::exception& e){
-        printf("parser() failed in Getter. std::exception caught: %s\n", e.what());
+        ES_LOG(ERROR, "parser() failed in Getter. std::exception caught: " << e.what());
         throw std::exception(e);
     }
     catch(...){
-        printf("parser() failed in Getter.\n");
+        ES_LOG(ERROR, "parser() failed in Getter.");
         EXCEPTION("Unknown exception.");
     }
 
@@ -310,10 +489,18 @@ bool HTTP::sendMessage(const char* method, const char* endUrl, const char* data,
     requestString += _url;
     requestString += std::string("\r\n");
     requestString += std::string("Accept: */*\r\n");
+    if(_acceptEncoding)
+        requestString += std::string("Accept-Encoding: gzip, deflate\r\n");
     if(_keepAlive)
         requestString += std::string("Connection: Keep-Alive\r\n");
     //requestString += "Connection: close\r\n";
 
+    // Headers of the trace hook, as the W3C traceparent.
+    if(_traceHook) {
+        for(const std::pair<std::string, std::string>& header : _trace.headers)
+            requestString += header.first + ": " + header.second + "\r\n";
+    }
+
     // If no data, send the header and return.
     if(data == 0){
         requestString += std::string("\r\n");
@@ -336,8 +523,16 @@ bool HTTP::sendMessage(const char* method, const char* endUrl, const char* data,
 
     assert(!error());
 
+    // Compress large bodies on the fly, the gzip stream is sent as chunks.
+    if(_compressionThreshold > 0 && dataSize >= _compressionThreshold) {
+        requestString += std::string("Content-Encoding: gzip\r\n");
+        requestString += std::string("Transfer-Encoding: chunked\r\n\r\n");
+
+        return writeCompressed(requestString, data, dataSize);
+    }
+
     // If size is small enough, send as one message with the header.
-    if(dataSize < 1024) {
+    if(dataSize < CHUNK_SIZE) {
         requestString += std::string("Content-length: ");
         requestString += std::to_string(dataSize);
         requestString += std::string("\r\n\r\n");
@@ -350,37 +545,103 @@ bool HTTP::sendMessage(const char* method, const char* endUrl, const char* data,
         return true;
     }
 
-    assert(dataSize >= 1024);
+    assert(dataSize >= CHUNK_SIZE);
     // If size is high then send the header and the rest as chunked message.
+    // The header and the chunks are coalesced in large writes, not one small packet each.
     requestString += std::string("Transfer-Encoding: chunked\r\n\r\n");
 
+    size_t totalSent = 0;
+    while(totalSent < dataSize){
+        size_t chunkSize = std::min(dataSize - totalSent, (size_t)CHUNK_SIZE);
+
+        if(!writeChunk(requestString, data + totalSent, chunkSize))
+            return false;
+
+        totalSent += chunkSize;
+    }
+
+    // Final chunk message
+    requestString += "0\r\n\r\n";
     if(!write(requestString))
         return false;
 
-    size_t totalSent = 0;
-    while(totalSent < dataSize){
-        size_t chunkSize = std::min(dataSize - totalSent, (size_t)1024);
+    return true;
+}
 
-        std::stringstream chunkSizeString;
-        chunkSizeString << std::hex << chunkSize;
+// Append one chunk of a chunked message to the buffer, written once large enough.
+bool HTTP::writeChunk(std::string& buffer, const char* data, size_t size) {
 
-        std::string chunk(chunkSizeString.str());
-        chunk += "\r\n";
-        chunk += std::string(data + totalSent, chunkSize);
-        chunk += "\r\n";
+    char chunkSize[24];
+    snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", size);
 
-        #if !defined(NDEBUG) && VERBOSE >= 4
-        show(chunk.c_str(), chunk.length(), __LINE__);
-        #endif
+    #if !defined(NDEBUG) && VERBOSE >= 4
+    show(data, size, __LINE__);
+    #endif
 
-        if(!write(chunk))
-            return false;
+    buffer += chunkSize;
+    buffer.append(data, size);
+    buffer += "\r\n";
 
-        totalSent += chunkSize;
+    if(buffer.size() < WRITE_BUFFER_SIZE)
+        return true;
+
+    bool written = write(buffer);
+    buffer.clear();
+    return written;
+}
+
+// Compress the data with gzip and send it as chunks after the buffer, never holding the whole compressed copy.
+bool HTTP::writeCompressed(std::string& buffer, const char* data, size_t dataSize) {
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    // Window bits above 15 write a gzip header instead of a zlib one.
+    if(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        EXCEPTION("Cannot initialize the gzip compression.");
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = 0;
+
+    char deflated[DEFLATE_CHUNK_SIZE];
+    size_t totalRead = 0;
+    int status = Z_OK;
+
+    try {
+        while(status != Z_STREAM_END) {
+
+            // Feed the input by pieces, avail_in is only 32 bits.
+            if(stream.avail_in == 0 && totalRead < dataSize) {
+                size_t size = std::min(dataSize - totalRead, (size_t)(1 << 20));
+                stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + totalRead));
+                stream.avail_in = size;
+                totalRead += size;
+            }
+
+            stream.next_out = reinterpret_cast<Bytef*>(deflated);
+            stream.avail_out = sizeof(deflated);
+
+            status = deflate(&stream, (totalRead == dataSize) ? Z_FINISH : Z_NO_FLUSH);
+            if(status == Z_STREAM_ERROR)
+                EXCEPTION("Error while compressing the request.");
+
+            size_t chunkSize = sizeof(deflated) - stream.avail_out;
+            if(chunkSize > 0 && !writeChunk(buffer, deflated, chunkSize)) {
+                deflateEnd(&stream);
+                return false;
+            }
+        }
     }
+    catch(...) {
+        deflateEnd(&stream);
+        throw;
+    }
+
+    deflateEnd(&stream);
 
     // Final chunk message
-    if(!write("0\r\n\r\n"))
+    buffer += "0\r\n\r\n";
+    if(!write(buffer))
         return false;
 
     return true;
@@ -396,23 +657,39 @@ bool HTTP::write(const std::string& outgoing) {
 
     assert( !error() );
 
-    ssize_t writeReturn = ::write(_sockfd, outgoing.c_str(), outgoing.length());
+    size_t totalWritten = 0;
+    while(totalWritten < outgoing.length()) {
 
-    if(writeReturn == 0) {
-        if(!connect())
-            EXCEPTION("write returned 0 and we could not reconnect.");
+        ssize_t writeReturn = ::write(_sockfd, outgoing.c_str() + totalWritten, outgoing.length() - totalWritten);
 
-        write(outgoing);
-    }
+        if(_metrics)
+            _metrics->written(writeReturn > 0 ? writeReturn : 0);
+        if(_traceHook && writeReturn > 0)
+            _trace.bytesSent += writeReturn;
 
-    if( writeReturn < 0 ){
-        error();
-        EXCEPTION(outgoing);
-    }
+        // The send buffer is full, wait until the server reads.
+        if( writeReturn < 0 && (errno == EWOULDBLOCK || errno == EAGAIN) ){
+            errno = 0;
 
-    if( outgoing.length() != (size_t)writeReturn ){
-        error();
-        EXCEPTION("we did not write everything we wanted to write.");
+            int ret = wait(true, _timeouts.read);
+            if(ret <= 0) {
+                disconnect();
+                EXCEPTION(ret == 0 ? "Timeout while writing the request." : "Error while writing the request.");
+            }
+            continue;
+        }
+
+        if( writeReturn < 0 ){
+            error();
+            EXCEPTION("we did not write everything we wanted to write.");
+        }
+
+        if( writeReturn == 0 ){
+            disconnect();
+            EXCEPTION("write returned 0, the connection is closed.");
+        }
+
+        totalWritten += writeReturn;
     }
 
     assert( !error() );
@@ -438,13 +715,31 @@ unsigned int HTTP::request(const char* method, const char* endUrl, const char* d
     ///
     /// Where /test.php is the URN and www.mariequantier.com is the URL.
 
+    ES_INSTRUMENT_REQUEST(method, endUrl);
+
     // Lock guard for every request.
     std::lock_guard<std::mutex> lock(_requestMutex);
 
+    // Do not inherit the errno of a previous failure of this thread.
+    errno = 0;
+
+    // Follow the request with the trace hook, the completion is reported even if the request throws.
+    TraceScope trace(_traceHook.get(), _trace, method, endUrl, _url);
+
+    // Default deadline of the client, unless the caller set an earlier one. The pool installs it once per
+    // operation, before the retries, this one only matters to a connection used alone.
+    RequestContext::Scope scope(_timeouts.request.count() > 0 ? RequestContext::Clock::now() + _timeouts.request : RequestContext::Clock::time_point::max());
+    throwIfAborted(RequestContext::current());
+
     // If this instance does not keep-alive the connection, we must reconnect each time.
-    if( !connected() || (connected() && !_keepAlive) || mustReconnect() ){
-        if(!connect())
-            EXCEPTION("Cannot reconnect.");
+    bool reused = connected() && _keepAlive && !mustReconnect();
+    if(!reused)
+        reconnect();
+    else {
+        if(_metrics)
+            _metrics->connectionReused();
+        if(_traceHook)
+            _trace.reused = true;
     }
 
     assert( !error() );
@@ -452,12 +747,49 @@ unsigned int HTTP::request(const char* method, const char* endUrl, const char* d
 
     unsigned int statusCode = 0;
 
-    if(!sendMessage(method, endUrl, data, content_type)) {
+    bool sent;
+    while(true) {
+        {
+            ES_INSTRUMENT_PHASE(SEND);
+            sent = sendMessage(method, endUrl, data, content_type);
+        }
+
+        if(sent) {
+            if(_traceHook) {
+                _trace.sent = TraceRequest::Clock::now() - _trace.start;
+                _traceHook->onBytesSent(_trace);
+            }
+
+            statusCode = readMessage(output, strcmp(method, "HEAD") == 0, result);
+        }
+
+        // The server or a load balancer may close an idle keep-alive connection. Closed before any byte of
+        // the response, the request was not processed, it is sent once more on a new connection whatever the method.
+        if(!reused || statusCode != 0 || (sent && !_closedByPeer))
+            break;
+
+        ES_LOG(DEBUG, "Keep-alive connection to " << _host << ":" << _port << " closed by the server, request sent again.");
+
+        reused = false;
+        output.clear();
+        disconnect();
+        reconnect();
+        if(_traceHook)
+            _trace.reused = false;
+    }
+
+    if(!sent) {
         result = ERROR;
         return statusCode;
     }
 
-    statusCode = readMessage(output, result);
+    if(_traceHook) {
+        _trace.statusCode = statusCode;
+        _trace.succeeded = (result == OK);
+    }
+
+    if(_metrics)
+        _metrics->request(method, result == OK ? statusCode : 0);
     if(result != OK) {
 
         // Clear ouput in case we didn't get the full response.
@@ -480,337 +812,177 @@ unsigned int HTTP::request(const char* method, const char* endUrl, const char* d
         }
     } */
 
-    result = OK;
+    // A complete response is returned whatever its status, the caller reads the status code.
+    result = (statusCode != 0) ? OK : ERROR;
     return statusCode;
 }
 
+// Open a new connection for the request.
+void HTTP::reconnect() {
+    ES_INSTRUMENT_PHASE(CONNECT);
+    try {
+        if(!connect())
+            EXCEPTION("Cannot reconnect.");
+    }
+    catch(...) {
+        if(_metrics)
+            _metrics->connectionFailed();
+        throw;
+    }
+
+    if(_metrics)
+        _metrics->connectionOpened();
+    if(_traceHook)
+        _trace.connect = TraceRequest::Clock::now() - _trace.start;
+}
+
 // Whole process to read the response from HTTP server.
-unsigned int HTTP::readMessage(std::string& output, Result& result) {
+unsigned int HTTP::readMessage(std::string& output, bool head, Result& result) {
 
-    unsigned int statusCode = 0;
+    ResponseReader reader(output, head);
+    _closedByPeer = false;
 
     // Need to loop (recursion may fail because pile up over the stack for large requests.
-    size_t contentLength = 0;
-    bool isChunked = false;
     do {
-        statusCode = readMessage(output, contentLength, isChunked, result);
+        readMessage(reader, result);
     } while(result == MORE_DATA);
 
-    return statusCode;
-}
-
-// Wait with select then start to read the message.
-unsigned int HTTP::readMessage(std::string& output, size_t& contentLength, bool& isChunked, Result& result) {
-
-    unsigned int statusCode = 0;
-
-    /// First, use select() with a timeout value to determine when the file descriptor is ready to be read.
-    assert( !error() );
-    assert( _sockfd >= 0 );
-
-    int fd = _sockfd;
-
-    // Time value before timeout.
-    timeval tval = {40, 0};
-
-    // Declare file descriptors.
-    fd_set readSet, errorSet;
-
-    FD_ZERO( &readSet);
-    FD_ZERO( &errorSet);
-    FD_SET( fd, &readSet);
-    FD_SET( fd, &errorSet);
-
-    assert( fd >= 0 );
-
-    int ret = select( fd + 1, &readSet, 0, &errorSet, &tval );
-
-    assert( !error() );
-
-    // Is error ?
-    if(ret < 0) {
+    // The connection cannot be reused if the response is incomplete or if the server closes it.
+    if(result != OK || !reader.keepAlive())
         disconnect();
-        result = ERROR;
-        return statusCode;
-    }
 
-    // Is timeout ?
-    if(ret == 0) {
-        result = ERROR;
-        return statusCode;
-    }
+    if(_metrics && result == OK)
+        _metrics->response(reader.chunked(), reader.hasContentLength());
 
-    // Check error on socket
-    if(FD_ISSET( fd, &errorSet)) {
-        error();
-        result = ERROR;
-        return statusCode;
-    }
+    // The status of a response that did not complete is not an answer, the node is considered silent.
+    if(result != OK)
+        return 0;
 
-    // Is read ?
-    if(FD_ISSET( fd, &readSet)) {
-        // Parse message.
-        return parseMessage(output, contentLength, isChunked, result);
+    unsigned int statusCode = reader.statusCode();
+
+    // Handle the different status' response.
+    switch(statusCode) {
+
+        // If created, then continue.
+        case 201:
+            break;
+
+        // If ok, then continue.
+        case 200:
+            break;
+
+        // If found, then continue.
+        case 302:
+            break;
+
+        // Bad Request
+        case 400:
+            ES_LOG(WARNING, "Status: Bad Request, you must reconsidered your request.");
+            result = ERROR;
+            break;
+
+        // If forbidden, it's over.
+        case 403:
+            ES_LOG(WARNING, "Status: Forbidden, you must reconsidered your request.");
+            result = ERROR;
+            break;
+
+        // If 404 then keep the complete response.
+        case 404:
+            break;
+
+        // If 500 then print the message and break.
+        case 500:
+            ES_LOG(WARNING, "Status: Internal Server Error.");
+            result = ERROR;
+            break;
+
+        // If unhandled state, return false.
+        default:
+            ES_LOG(WARNING, "Weird status code: " << statusCode);
+            result = ERROR;
+            break;
     }
 
-    result = OK;
     return statusCode;
 }
 
-// Append char* to output.
-size_t HTTP::appendChunk(std::string& output, char* msg, size_t msgSize) {
-    assert(msgSize > 0);
-
-    #if !defined(NDEBUG) && VERBOSE >= 4
-    show(msg, msgSize, __LINE__);
-    #endif
-
-    char* afterSize;
-    size_t chunkSize = strtol(msg, &afterSize, 16);
-
-    if(error())
-        return 0;
-
-    if(chunkSize == 0)
-        return 0;
-
+// Wait with select then start to read the message.
+void HTTP::readMessage(ResponseReader& reader, Result& result) {
 
-    // Move after the /r/n characters.
-    afterSize += 2;
+    /// First, use select() with a timeout value to determine when the file descriptor is ready to be read.
+    assert( !error() );
+    assert( _sockfd >= 0 );
 
-    assert(msgSize + msg > afterSize + 2);
+    int ret;
+    {
+        ES_INSTRUMENT_PHASE(WAIT);
+        ret = wait(false, _timeouts.read);
+    }
 
-    // Append the result to the output; remove the \r\n as line separator.
-    if(chunkSize + afterSize + 2 <= msgSize + msg)
-        // The chunksize is smaller, we take only the given size.
-        output.append(afterSize, chunkSize);
-    else{
-        // If the chunksize is higher, we take only what we got in the answer.
-        output.append(afterSize, msgSize - (afterSize - msg));
+    // Is error or timeout ?
+    if(ret <= 0) {
+        // A timeout is no proof the server dropped the request.
+        _closedByPeer = (ret < 0 && reader.received() == 0);
+        result = ERROR;
+        return;
     }
 
-    return chunkSize;
+    // Parse message.
+    ES_INSTRUMENT_PHASE(READ);
+    parseMessage(reader, result);
 }
 
-// Whole process to read the response from HTTP server.
-unsigned int HTTP::parseMessage(std::string& output, size_t& contentLength, bool& isChunked, Result& result) {
-
-        unsigned int statusCode = 0;
-
-        // Socket is ready for reading.
-        char recvline[4096];
-        ssize_t readSize = read(_sockfd, recvline, 4095);
-
-        if(readSize <= 0) {
-
-            if(!connect()) {
-                result = ERROR;
-                return statusCode;
-            }
+// Read what is available on the socket and feed the response reader.
+void HTTP::parseMessage(ResponseReader& reader, Result& result) {
 
-            if( readSize < 0 ) {
-                if(errno != (EWOULDBLOCK | EAGAIN) )
-                    EXCEPTION("read error on socket");
-                errno = 0;
-            }
-
-            result = MORE_DATA;
-            return statusCode;
-        }
+    char recvline[READ_BUFFER_SIZE];
 
-        assert(readSize <= 4095);
-
-        // If we already got the header from a non chunked message.
-        if(contentLength > 0) {
-            // If we have the content length, append the result to the output.
-            output.append(recvline, readSize);
-        }
-
-        // If we already got the header from a chunked message.
-        if(contentLength == 0 && isChunked) {
+    do {
+        ssize_t readSize = read(_sockfd, recvline, sizeof(recvline));
 
-            // We already tested that the readSize is not 0.
-            contentLength = appendChunk(output, recvline, readSize);
+        if(_metrics)
+            _metrics->read(readSize > 0 ? readSize : 0);
+        ES_INSTRUMENT_RECEIVED(readSize > 0 ? readSize : 0);
 
-            // Append the message to the output.
-            if( contentLength == 0 ) {
-                result = OK;
-                return statusCode;
+        if(_traceHook && readSize > 0) {
+            if(_trace.bytesReceived == 0) {
+                _trace.firstByte = TraceRequest::Clock::now() - _trace.start;
+                _traceHook->onFirstByte(_trace);
             }
+            _trace.bytesReceived += readSize;
         }
 
-        // If this method is called with no contentLength, parse the header.
-        if(contentLength == 0 && !isChunked) {
-
-            char* endStatus = strstr(recvline,"\r\n");
-
-            if(endStatus == NULL) {
-                disconnect();
-                result = ERROR;
-                return statusCode;
-            }
-
-            // Extract and interpret status line.
-            std::stringstream status( std::string(recvline, endStatus) );
-
-            if (!status) {
-                disconnect();
-                result = ERROR;
-                return statusCode;
-            }
-
-            std::string httpVersion;
-            status >> httpVersion;
-
-            if (httpVersion.substr(0, 5) != "HTTP/") {
-                disconnect();
-                result = ERROR;
-                return statusCode;
-            }
-
-            status >> statusCode;
-
-            // Extract status message.
-            std::stringstream statusMessage;
-            status >> statusMessage.rdbuf();
-
-            // Handle the different status' response.
-            switch(statusCode) {
-
-                // If created, then continue.
-                case 201:
-                    break;
-
-                // If ok, then continue.
-                case 200:
-                    break;
-
-                // If found, then continue.
-                case 302:
-                    break;
-
-                // Bad Request
-                case 400:
-                    std::cout << "Status: Bad Request, you must reconsidered your request." << std::endl;
-                    disconnect();
-                    result = ERROR;
-                    return statusCode;
-
-                // If forbidden, it's over.
-                case 403:
-                    std::cout << "Status: Forbidden, you must reconsidered your request." << std::endl;
-                    disconnect();
-                    result = ERROR;
-                    return statusCode;
-
-                // If 404 then check the message and continue to get the complete response.
-                case 404:
-                    std::cout << " 404 but statusMessage is not \"Not Found\"." << std::endl;
-                    disconnect();
-                    break;
-
-                // If 500 then print the message and break.
-                case 500:
-                    std::cout << " 500 but statusMessage is not \"Internal Server Error\"." << std::endl;
-                    disconnect();
-                    result = ERROR;
-                    return statusCode;
-
-                // If unhandled state, return false.
-                default:
-                    std::cout << "Weird status code: " << statusCode << std::endl;
-                    disconnect();
-                    result = ERROR;
-                    return statusCode;
-            }
-
-            // Extract and interpret the header.
-            char* endHeader = strstr(endStatus+2,"\r\n\r\n");
-            if(endHeader == NULL) {
-                disconnect();
-                result = ERROR;
-                return statusCode;
-            }
-            size_t headerSize = endHeader + 4 - recvline;
-
-            // Extract and interpret the header.
-            char* contentLenghtPos = strstr(endStatus+2,"Content-Length:");
-
-            // If we've got the content-length.
-            if(contentLenghtPos == NULL){
-
-                // If the message is chunked, restart the method with the flag on.
-                if( strstr(endStatus+2,"Transfer-Encoding: chunked") != NULL ){
-                    // Set the transfer as chunked.
-                    isChunked = true;
-
-                    // If we did not get the size of the chunk read message as a chunk, go on reading.
-                    if(readSize - headerSize <= 0) {
-                        result = MORE_DATA;
-                        return statusCode;
-                    }
-
-                    // If the message content the length, parse the size.
-                    contentLength = appendChunk(output, endHeader + 4, readSize - headerSize);
-
-                    if(contentLength == 0) {
-                        result = OK;
-                        return statusCode;
-                    }
-
-                } else {
-                    disconnect();
-                    result = ERROR;
-                    return statusCode;
-                }
-            }
-            // We received the content-length.
-            else {
-                contentLength = atoi(contentLenghtPos + 15);
-
-                // Error due to conversion may set errno.
-                if(error()) {
-                    result = ERROR;
-                    return statusCode;
-                }
-
-                // Copy content.
-                assert( endHeader - recvline + contentLength + 4 >= (unsigned int)readSize);
-                output.append(endHeader+4, readSize - headerSize);
-            }
+        // The server closed the connection.
+        if(readSize == 0) {
+            _closedByPeer = (reader.received() == 0);
+            result = reader.finish();
+            return;
         }
 
-        while( output.length() <  contentLength) {
-            char nextContent[4096];
-            readSize = read(_sockfd, nextContent, 4095);
-
-            // When we did not receive the data yet. Wait with select.
-            if( readSize == 0 ) {
-                result = MORE_DATA;
-                return statusCode;
-            }
-
-            // When there is nothing more to read but the output is incomplete, wait with select.
-            if( readSize < 0 ) {
-
-                if(errno != (EWOULDBLOCK | EAGAIN) )
-                    EXCEPTION("read error on socket");
+        // When there is nothing more to read but the response is incomplete, wait with select.
+        if(readSize < 0) {
+            if(errno == EWOULDBLOCK || errno == EAGAIN) {
                 errno = 0;
                 result = MORE_DATA;
-                return statusCode;
+                return;
             }
 
-            output.append(nextContent, readSize);
+            _closedByPeer = (reader.received() == 0);
+            error();
+            result = ERROR;
+            return;
         }
 
-        // If chunked but no size, we return until we receive the answer.
-        if(isChunked && contentLength == 0) {
-            result = MORE_DATA;
-            return statusCode;
+        // Linux falls back to delayed acknowledgments, re-arm the quick mode after each read.
+        #ifdef TCP_QUICKACK
+        if(_socketOptions.quickAck) {
+            int value = 1;
+            setsockopt(_sockfd, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
         }
+        #endif
 
-    result = OK;
-    return statusCode;
-}
-
+        result = reader.feed(recvline, readSize);
 
+    } while(result == MORE_DATA);
+}
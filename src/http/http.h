@@ -22,12 +22,19 @@
 
 #include <string>
 #include <mutex>
+#include <chrono>
+#include <memory>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <iostream>
 
 #include "json/json.h"
+#include "log/log.h"
+#include "trace.h"
+
+struct Address;
+class ResponseReader;
 
 #define _TEXT_PLAIN "text/plain"
 #define _APPLICATION_JSON "application/json"
@@ -51,8 +58,9 @@ class Exception : std::exception {
 template<typename T>
 Exception::Exception(const char* fil, int lin, T const& msg) {
     _msg = msg;
-    std::cerr << "Exception in "<< fil << " l. " << lin << " ->\n";
-    std::cerr << msg << std::endl;
+
+    // Most are caught and handled by the client, not worth more than a debug message.
+    ES_LOG(DEBUG, "Exception in " << fil << " l. " << lin << " -> " << msg);
 }
 
 enum Result {
@@ -61,11 +69,69 @@ enum Result {
     MORE_DATA
 };
 
+/// Timeouts of the connections, the deadline of the request (see RequestContext) shortens them.
+struct Timeouts {
+    Timeouts() : connect(5000), read(40000), keepAlive(60), request(0) {}
+
+    /// Time to establish a connection.
+    std::chrono::milliseconds connect;
+
+    /// Longest wait for the next bytes of the response, or for the socket to accept the request.
+    std::chrono::milliseconds read;
+
+    /// Idle time after which a keep-alive connection is not reused.
+    std::chrono::seconds keepAlive;
+
+    /// Default deadline of every request, zero for none.
+    std::chrono::milliseconds request;
+};
+
+/// Options of the sockets, applied to every new connection.
+struct SocketOptions {
+    SocketOptions() : noDelay(true), receiveBuffer(0), sendBuffer(0), keepAlive(false), keepAliveIdle(60), keepAliveInterval(10), keepAliveCount(5), quickAck(false) {}
+
+    /// Disable Nagle's algorithm (TCP_NODELAY), small requests are sent without delay.
+    bool noDelay;
+
+    /// Size of the kernel buffers (SO_RCVBUF, SO_SNDBUF), 0 for the system default.
+    int receiveBuffer;
+    int sendBuffer;
+
+    /// Probe idle connections (SO_KEEPALIVE) so that dead peers are detected.
+    bool keepAlive;
+
+    /// Idle time before the first probe, time between probes and probes before the connection is dropped.
+    std::chrono::seconds keepAliveIdle;
+    std::chrono::seconds keepAliveInterval;
+    int keepAliveCount;
+
+    /// Acknowledge the responses immediately (TCP_QUICKACK), Linux only.
+    bool quickAck;
+};
+
+class HTTPMetrics;
+
 class HTTP {
     public:
         HTTP(std::string url, bool keepAlive);
         ~HTTP();
 
+        /// Timeouts of the next requests.
+        void setTimeouts(const Timeouts& timeouts);
+
+        /// Options of the next connections.
+        void setSocketOptions(const SocketOptions& options);
+
+        /// Compress the request bodies from the given size with gzip, 0 to disable.
+        /// Advertise that compressed responses are accepted, they are inflated while read.
+        void setCompression(size_t threshold, bool acceptEncoding);
+
+        /// Counters of the connection and its requests, null for none.
+        void setMetrics(const std::shared_ptr<HTTPMetrics>& metrics);
+
+        /// Hook following every request, null for none.
+        void setTraceHook(const std::shared_ptr<TraceHook>& hook);
+
         /// DEPRECATED
         /// Generic request that parses the result in Json::Object.
         bool request(const char* method, const char* endUrl, const char* data, Json::Object* root, const char* content_type = _APPLICATION_JSON);
@@ -121,46 +187,82 @@ class HTTP {
         /// Returns true if managed to connect.
         bool connect();
 
+        /// Connect to one address of the host.
+        bool connect(const Address& address);
+
+        /// Open a new connection for the request, counted and traced. Throws on failure.
+        void reconnect();
+
+        /// Apply the socket options to the new socket.
+        void applySocketOptions();
+
         /// Parse the message and split if necessary.
         bool sendMessage(const char* method, const char* endUrl, const char* data, const char* content_type);
 
         /// Write string on the socketfd.
         bool write(const std::string& outgoing);
 
+        /// Append one chunk of a chunked message to the buffer, written once large enough.
+        bool writeChunk(std::string& buffer, const char* data, size_t size);
+
+        /// Compress the data with gzip and send it as chunks after the buffer.
+        bool writeCompressed(std::string& buffer, const char* data, size_t dataSize);
+
         /// Test socket point.
         inline bool connected() const { return (_sockfd >= 0); }
 
         /// Close the socket.
         void disconnect();
 
-        /// Whole process to read the response from HTTP server.
-        unsigned int readMessage(std::string& output, Result& result);
+        /// Wait until the socket is readable or writable, within the timeout and the deadline of the request.
+        /// Returns 1 when ready, 0 on timeout and -1 on error, throws if the request is cancelled or over its deadline.
+        int wait(bool forWrite, std::chrono::milliseconds timeout);
 
-        /// Wait with select then start to read the message.
-        unsigned int readMessage(std::string& output, size_t& contentLength, bool& isChunked, Result& result);
+        /// Whole process to read the response from HTTP server, there is no body for HEAD.
+        unsigned int readMessage(std::string& output, bool head, Result& result);
 
-        /// Methods to read chunked messages.
-        unsigned int parseMessage(std::string& output, size_t& contentLength, bool& isChunked, Result& result);
+        /// Wait with select then start to read the message.
+        void readMessage(ResponseReader& reader, Result& result);
 
-        /// Append the chunk message to the stream.
-        size_t appendChunk(std::string& output, char* msg, size_t msgSize);
+        /// Read what is available on the socket and feed the response reader.
+        void parseMessage(ResponseReader& reader, Result& result);
 
         /// Check if the connection is on error state.
         bool error();
 
         /// Determine if we must reconnect.
-        inline bool mustReconnect() const { return (_keepAliveTimeout <= time(NULL) - _lastRequest); }
+        inline bool mustReconnect() const { return (_timeouts.keepAlive.count() <= time(NULL) - _lastRequest); }
 
         std::string _url;
         std::string _urn;
+        std::string _host;
         int _port;
-        unsigned int _connection;
         int _sockfd;
-        struct sockaddr_in _client;
         bool _keepAlive;
-        time_t _keepAliveTimeout;
         time_t _lastRequest;
 
+        /// The server closed or reset the connection before any byte of the response.
+        bool _closedByPeer;
+
+        /// Timeouts of the connection and the requests.
+        Timeouts _timeouts;
+
+        /// Options of the sockets.
+        SocketOptions _socketOptions;
+
+        /// Size from which the request bodies are compressed, 0 if never.
+        size_t _compressionThreshold;
+
+        /// Advertise gzip and deflate for the responses.
+        bool _acceptEncoding;
+
+        /// Counters shared with the other connections of the pool.
+        std::shared_ptr<HTTPMetrics> _metrics;
+
+        /// Hook shared with the other connections of the pool, and the request it follows.
+        std::shared_ptr<TraceHook> _traceHook;
+        TraceRequest _trace;
+
         /// Mutex for every request.
         std::mutex _requestMutex;
 };
@@ -0,0 +1,290 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include "instrumentation.h"
+
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+Histogram::Histogram(): _count(0), _sum(0), _max(0) {
+    for(unsigned int i = 0; i < BucketCount; ++i)
+        _buckets[i].store(0, std::memory_order_relaxed);
+}
+
+// Bucket of a duration: linear below 16 ns, then 16 sub-buckets per power of two.
+unsigned int Histogram::index(uint64_t value) {
+    if(value < SubBuckets)
+        return static_cast<unsigned int>(value);
+
+    value = std::min<uint64_t>(value, (uint64_t(1) << MaxExponent) - 1);
+
+    unsigned int exponent = 63 - __builtin_clzll(value);
+    unsigned int shift = exponent - SubBucketBits;
+    return (shift + 1) * SubBuckets + static_cast<unsigned int>((value >> shift) - SubBuckets);
+}
+
+// Middle of the range of a bucket.
+uint64_t Histogram::value(unsigned int index) {
+    if(index < SubBuckets)
+        return index;
+
+    unsigned int shift = index / SubBuckets - 1;
+    uint64_t lower = static_cast<uint64_t>(SubBuckets + index % SubBuckets) << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+}
+
+// Add a duration.
+void Histogram::record(uint64_t nanoseconds) {
+    _buckets[index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while(nanoseconds > max && !_max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+        ;
+}
+
+// Duration at the percentile, the buckets may move while they are read.
+uint64_t Histogram::percentile(double percentile) const {
+    uint64_t counts[BucketCount];
+    uint64_t total = 0;
+    for(unsigned int i = 0; i < BucketCount; ++i) {
+        counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if(total == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(percentile / 100. * total + 0.5);
+    rank = std::max<uint64_t>(std::min(rank, total), 1);
+
+    uint64_t seen = 0;
+    for(unsigned int i = 0; i < BucketCount; ++i) {
+        seen += counts[i];
+        if(seen >= rank)
+            return std::min(value(i), max());
+    }
+
+    return max();
+}
+
+// Scope of the current request of the thread.
+static thread_local Instrumentation::Scope* currentScope = 0;
+
+// Last request of the thread.
+static thread_local Instrumentation::Request lastThreadRequest;
+
+Instrumentation::Request::Request()
+: sequence(0),
+  operation(OTHER),
+  received(0)
+{
+    std::fill(phases, phases + PhaseCount, 0);
+}
+
+Instrumentation::Scope::Scope(const char* method, const char* endUrl)
+: _outermost(currentScope == 0)
+{
+    if(!_outermost)
+        return;
+
+    _operation = classify(method, endUrl);
+    _start = std::chrono::steady_clock::now();
+    std::fill(_phases, _phases + PhaseCount, 0);
+    _received = 0;
+    currentScope = this;
+}
+
+// Record the phases of the request.
+Instrumentation::Scope::~Scope() {
+    if(!_outermost)
+        return;
+
+    currentScope = 0;
+    _phases[TOTAL] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+
+    Instrumentation& instrumentation = Instrumentation::instance();
+    for(int phase = 0; phase < PhaseCount; ++phase) {
+        // A reused connection has no connect phase.
+        if(phase == CONNECT && _phases[phase] == 0)
+            continue;
+
+        instrumentation.record(_operation, static_cast<Phase>(phase), _phases[phase]);
+    }
+
+    ++lastThreadRequest.sequence;
+    lastThreadRequest.operation = _operation;
+    std::copy(_phases, _phases + PhaseCount, lastThreadRequest.phases);
+    lastThreadRequest.received = _received;
+}
+
+// Add bytes read on the socket to the current request.
+void Instrumentation::Scope::received(uint64_t bytes) {
+    if(currentScope != 0)
+        currentScope->_received += bytes;
+}
+
+Instrumentation::PhaseTimer::PhaseTimer(Phase phase)
+: _scope(currentScope),
+  _phase(phase)
+{
+    if(_scope != 0)
+        _start = std::chrono::steady_clock::now();
+}
+
+Instrumentation::PhaseTimer::~PhaseTimer() {
+    if(_scope != 0)
+        _scope->_phases[_phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+}
+
+Instrumentation::Instrumentation() {
+}
+
+// Last request of the thread.
+const Instrumentation::Request& Instrumentation::lastRequest() {
+    return lastThreadRequest;
+}
+
+// Process wide instrumentation.
+Instrumentation& Instrumentation::instance() {
+    static Instrumentation instrumentation;
+    return instrumentation;
+}
+
+// Operation of a request from its method and the elements of its path.
+Instrumentation::Operation Instrumentation::classify(const char* method, const char* endUrl) {
+
+    if(endUrl != 0) {
+        const char* end = strchr(endUrl, '?');
+        if(end == 0)
+            end = endUrl + strlen(endUrl);
+
+        const char* begin = endUrl;
+        while(begin < end) {
+            const char* slash = std::find(begin, end, '/');
+            size_t length = slash - begin;
+
+            if(length > 1 && *begin == '_') {
+                std::string element(begin, length);
+
+                if(element == "_search" || element == "_msearch")
+                    return (slash < end && strncmp(slash, "/scroll", 7) == 0) ? SCROLL : SEARCH;
+                if(element == "_count")
+                    return COUNT;
+                if(element == "_mget")
+                    return GET;
+                if(element == "_bulk")
+                    return BULK;
+                if(element == "_update" || element == "_update_by_query")
+                    return UPDATE;
+                if(element == "_delete_by_query")
+                    return DELETE;
+                if(element == "_doc" || element == "_create")
+                    break;
+
+                // Cluster and index administration.
+                return OTHER;
+            }
+
+            begin = slash + 1;
+        }
+    }
+
+    // Requests on a document by id.
+    if(strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0)
+        return GET;
+    if(strcmp(method, "PUT") == 0 || strcmp(method, "POST") == 0)
+        return INDEX;
+    if(strcmp(method, "DELETE") == 0)
+        return DELETE;
+
+    return OTHER;
+}
+
+const char* Instrumentation::name(Operation operation) {
+    static const char* names[] = { "search", "scroll", "count", "get", "index", "update", "delete", "bulk", "other" };
+    return names[operation];
+}
+
+const char* Instrumentation::name(Phase phase) {
+    static const char* names[] = { "connect", "send", "wait", "read", "parse", "total" };
+    return names[phase];
+}
+
+// Durations of the phases recorded so far.
+std::vector<Instrumentation::Entry> Instrumentation::snapshot() const {
+    std::vector<Entry> entries;
+
+    for(int operation = 0; operation < OperationCount; ++operation) {
+        for(int phase = 0; phase < PhaseCount; ++phase) {
+            const Histogram& histogram = _histograms[operation][phase];
+            if(histogram.count() == 0)
+                continue;
+
+            Entry entry;
+            entry.operation = static_cast<Operation>(operation);
+            entry.phase = static_cast<Phase>(phase);
+            entry.count = histogram.count();
+            entry.sum = histogram.sum();
+            entry.max = histogram.max();
+            entry.p50 = histogram.percentile(50.);
+            entry.p90 = histogram.percentile(90.);
+            entry.p99 = histogram.percentile(99.);
+            entry.p999 = histogram.percentile(99.9);
+            entries.push_back(entry);
+        }
+    }
+
+    return entries;
+}
+
+// Durations in the Prometheus text format.
+std::string Instrumentation::prometheus() const {
+    static const char* metric = "elasticsearch_client_request_phase_seconds";
+
+    std::string output("# HELP ");
+    output += metric;
+    output += " Time spent in each phase of the requests.\n# TYPE ";
+    output += metric;
+    output += " summary\n";
+
+    char line[256];
+    std::vector<Entry> entries = snapshot();
+    for(const Entry& entry : entries) {
+        const char* operation = name(entry.operation);
+        const char* phase = name(entry.phase);
+
+        const std::pair<const char*, uint64_t> quantiles[] = { {"0.5", entry.p50}, {"0.9", entry.p90}, {"0.99", entry.p99}, {"0.999", entry.p999} };
+        for(const std::pair<const char*, uint64_t>& quantile : quantiles) {
+            snprintf(line, sizeof(line), "%s{operation=\"%s\",phase=\"%s\",quantile=\"%s\"} %.9f\n", metric, operation, phase, quantile.first, quantile.second / 1e9);
+            output += line;
+        }
+
+        snprintf(line, sizeof(line), "%s_sum{operation=\"%s\",phase=\"%s\"} %.9f\n", metric, operation, phase, entry.sum / 1e9);
+        output += line;
+        snprintf(line, sizeof(line), "%s_count{operation=\"%s\",phase=\"%s\"} %llu\n", metric, operation, phase, static_cast<unsigned long long>(entry.count));
+        output += line;
+    }
+
+    return output;
+}
@@ -0,0 +1,174 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/// Define CPPES_NO_INSTRUMENTATION to compile the timers of the request phases out.
+#ifndef CPPES_NO_INSTRUMENTATION
+#define ES_INSTRUMENT_REQUEST(method, endUrl) Instrumentation::Scope _instrumentationScope(method, endUrl)
+#define ES_INSTRUMENT_PHASE(phase) Instrumentation::PhaseTimer _instrumentationPhase(Instrumentation::phase)
+#define ES_INSTRUMENT_RECEIVED(bytes) Instrumentation::Scope::received(bytes)
+#else
+#define ES_INSTRUMENT_REQUEST(method, endUrl)
+#define ES_INSTRUMENT_PHASE(phase)
+#define ES_INSTRUMENT_RECEIVED(bytes)
+#endif
+
+/// Lock free histogram of durations in nanoseconds, HDR style: 16 linear sub-buckets per power of two,
+/// the value of a percentile is exact to about 6%.
+class Histogram {
+    public:
+        Histogram();
+
+        /// Add a duration.
+        void record(uint64_t nanoseconds);
+
+        /// Number of durations, their sum and the largest one.
+        inline uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+        inline uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+        inline uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+        /// Duration at the percentile, between 0 and 100.
+        uint64_t percentile(double percentile) const;
+
+    private:
+        static const unsigned int SubBucketBits = 4;
+        static const unsigned int SubBuckets = 1u << SubBucketBits;
+
+        /// Durations are capped to 2^41 ns, about 36 minutes.
+        static const unsigned int MaxExponent = 41;
+        static const unsigned int BucketCount = (MaxExponent - SubBucketBits + 1) * SubBuckets;
+
+        /// Bucket of a duration and middle of the range of a bucket.
+        static unsigned int index(uint64_t value);
+        static uint64_t value(unsigned int index);
+
+        std::atomic<uint64_t> _buckets[BucketCount];
+        std::atomic<uint64_t> _count;
+        std::atomic<uint64_t> _sum;
+        std::atomic<uint64_t> _max;
+};
+
+/// Durations of the phases of the requests per operation: connect, send, wait for the socket, read and JSON parsing.
+class Instrumentation {
+    public:
+        enum Operation { SEARCH, SCROLL, COUNT, GET, INDEX, UPDATE, DELETE, BULK, OTHER, OperationCount };
+        enum Phase { CONNECT, SEND, WAIT, READ, PARSE, TOTAL, PhaseCount };
+
+        /// Durations of one phase of one operation, in nanoseconds.
+        struct Entry {
+            Operation operation;
+            Phase phase;
+            uint64_t count;
+            uint64_t sum;
+            uint64_t max;
+            uint64_t p50;
+            uint64_t p90;
+            uint64_t p99;
+            uint64_t p999;
+        };
+
+        /// The phases of a request of the thread and the bytes received for it.
+        struct Request {
+            Request();
+
+            /// Requests of the thread ended so far, this one included.
+            uint64_t sequence;
+            Operation operation;
+            uint64_t phases[PhaseCount];
+            uint64_t received;
+        };
+
+        class PhaseTimer;
+
+        /// Time spent in each phase of the current request of the thread, recorded when the outermost scope ends.
+        /// Nested scopes add to the outer one.
+        class Scope {
+            public:
+                Scope(const char* method, const char* endUrl);
+                ~Scope();
+
+                /// Add bytes read on the socket to the current request, if any.
+                static void received(uint64_t bytes);
+
+            private:
+                friend class PhaseTimer;
+
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+
+                bool _outermost;
+                Operation _operation;
+                std::chrono::steady_clock::time_point _start;
+                uint64_t _phases[PhaseCount];
+                uint64_t _received;
+        };
+
+        /// Add the time until its destruction to a phase of the current request, if any.
+        class PhaseTimer {
+            public:
+                explicit PhaseTimer(Phase phase);
+                ~PhaseTimer();
+
+            private:
+                PhaseTimer(const PhaseTimer&) = delete;
+                PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+                Scope* _scope;
+                Phase _phase;
+                std::chrono::steady_clock::time_point _start;
+        };
+
+        /// Process wide instrumentation.
+        static Instrumentation& instance();
+
+        /// Operation of a request from its method and its path.
+        static Operation classify(const char* method, const char* endUrl);
+
+        /// Last request of the thread, kept when its outermost scope ended. Nothing is kept if the instrumentation is compiled out.
+        static const Request& lastRequest();
+
+        static const char* name(Operation operation);
+        static const char* name(Phase phase);
+
+        /// Add a duration to a phase of an operation.
+        inline void record(Operation operation, Phase phase, uint64_t nanoseconds) { _histograms[operation][phase].record(nanoseconds); }
+
+        /// Durations of the phases recorded so far, only the ones seen at least once.
+        std::vector<Entry> snapshot() const;
+
+        /// Durations in the Prometheus text format, as summaries in seconds.
+        std::string prometheus() const;
+
+    private:
+        Instrumentation();
+
+        Histogram _histograms[OperationCount][PhaseCount];
+};
+
+#endif // INSTRUMENTATION_H
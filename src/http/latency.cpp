@@ -0,0 +1,59 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "latency.h"
+
+#include <vector>
+#include <algorithm>
+
+/// The percentile is recomputed every this number of samples.
+#define LATENCY_UPDATE_PERIOD 64
+
+LatencyTracker::LatencyTracker(double percentile, std::chrono::microseconds initial, size_t samples)
+: _percentile(std::min(std::max(percentile, 0.0), 1.0)),
+  _size(std::max<size_t>(samples, 1)),
+  _samples(new std::atomic<long long>[_size]),
+  _count(0),
+  _value(initial.count())
+{
+    for(size_t i = 0; i < _size; ++i)
+        _samples[i].store(0, std::memory_order_relaxed);
+}
+
+// Add the latency of a request.
+void LatencyTracker::record(std::chrono::microseconds latency) {
+    size_t count = _count.fetch_add(1, std::memory_order_relaxed);
+    _samples[count % _size].store(latency.count(), std::memory_order_relaxed);
+
+    if(count + 1 >= _size && (count + 1) % LATENCY_UPDATE_PERIOD == 0)
+        update();
+}
+
+// Recompute the percentile from the ring.
+void LatencyTracker::update() {
+    std::vector<long long> samples(_size);
+    for(size_t i = 0; i < _size; ++i)
+        samples[i] = _samples[i].load(std::memory_order_relaxed);
+
+    size_t rank = std::min(static_cast<size_t>(_percentile * _size), _size - 1);
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+
+    _value.store(samples[rank], std::memory_order_relaxed);
+}
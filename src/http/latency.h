@@ -0,0 +1,55 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+/// Percentile of the latencies of the recent requests, over a ring of the last samples.
+/// Recording is lock free, the percentile is recomputed every few samples and read without lock.
+class LatencyTracker {
+    public:
+        LatencyTracker(double percentile, std::chrono::microseconds initial, size_t samples = 1024);
+
+        /// Add the latency of a request.
+        void record(std::chrono::microseconds latency);
+
+        /// Latency at the percentile of the last samples, the initial one until the ring is filled.
+        inline std::chrono::microseconds percentile() const { return std::chrono::microseconds(_value.load(std::memory_order_relaxed)); }
+
+    private:
+        /// Recompute the percentile from the ring.
+        void update();
+
+        double _percentile;
+        size_t _size;
+
+        /// Ring of the last latencies in microseconds.
+        std::unique_ptr< std::atomic<long long>[] > _samples;
+        std::atomic<size_t> _count;
+
+        /// Last computed percentile in microseconds.
+        std::atomic<long long> _value;
+};
+
+#endif // LATENCY_H
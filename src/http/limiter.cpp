@@ -0,0 +1,104 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "limiter.h"
+#include "context.h"
+
+#include <algorithm>
+
+/// Longest wait between two checks of the cancellation of a waiting request.
+#define LIMITER_POLL_MILLISECONDS 10
+
+ConcurrencyLimiter::ConcurrencyLimiter()
+: _enabled(false),
+  _limit(0),
+  _inflight(0)
+{
+}
+
+// Enable the limiter with the settings, or disable it.
+void ConcurrencyLimiter::configure(bool enabled, const Settings& settings) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _enabled.store(enabled, std::memory_order_relaxed);
+    _settings = settings;
+    _settings.minLimit = std::max(_settings.minLimit, 1u);
+    _settings.maxLimit = std::max(_settings.maxLimit, _settings.minLimit);
+    _limit = std::min(std::max(_settings.initialLimit, _settings.minLimit), _settings.maxLimit);
+    _released.notify_all();
+}
+
+// Wait for a slot, within the deadline of the request.
+bool ConcurrencyLimiter::acquire() {
+    if(!_enabled.load(std::memory_order_relaxed))
+        return true;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    const RequestContext& context = RequestContext::current();
+    while(_inflight >= static_cast<unsigned int>(_limit)) {
+        if(context.aborted())
+            return false;
+
+        std::chrono::milliseconds wait = context.remaining(std::chrono::milliseconds(LIMITER_POLL_MILLISECONDS));
+        _released.wait_for(lock, wait);
+    }
+
+    ++_inflight;
+    return true;
+}
+
+// Give back the slot and adapt the limit to the outcome.
+void ConcurrencyLimiter::release(Outcome outcome, std::chrono::microseconds latency) {
+    if(!_enabled.load(std::memory_order_relaxed))
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // The slot may have been taken while the limiter was disabled.
+    if(_inflight == 0)
+        return;
+
+    unsigned int inflight = _inflight--;
+
+    if(outcome == DROPPED || (outcome == ANSWERED && latency >= _settings.latencyThreshold))
+        _limit = std::max<double>(_limit * _settings.backoffRatio, _settings.minLimit);
+
+    // Only grow a limit that is used, otherwise it says nothing of the capacity.
+    else if(outcome == ANSWERED && 2 * inflight >= _limit)
+        _limit = std::min<double>(_limit + 1.0 / _limit, _settings.maxLimit);
+
+    _released.notify_one();
+}
+
+// Tells if no slot is free.
+bool ConcurrencyLimiter::full() const {
+    if(!_enabled.load(std::memory_order_relaxed))
+        return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inflight >= static_cast<unsigned int>(_limit);
+}
+
+// Current limit.
+unsigned int ConcurrencyLimiter::limit() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return static_cast<unsigned int>(_limit);
+}
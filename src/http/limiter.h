@@ -0,0 +1,86 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef LIMITER_H
+#define LIMITER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+/// Adaptive limit of the requests in flight on a node (AIMD). The limit grows by one for every limit
+/// requests answered in time while it is used, and is cut by the backoff ratio when the node signals
+/// overload: no answer, 429, 503, 504 or a latency over the threshold. Requests over the limit wait for a slot.
+class ConcurrencyLimiter {
+    public:
+        struct Settings {
+            Settings() : initialLimit(20), minLimit(1), maxLimit(500), backoffRatio(0.9), latencyThreshold(1000) {}
+
+            unsigned int initialLimit;
+            unsigned int minLimit;
+            unsigned int maxLimit;
+
+            /// Factor applied to the limit on overload.
+            double backoffRatio;
+
+            /// Latency from which an answer is an overload signal.
+            std::chrono::milliseconds latencyThreshold;
+        };
+
+        enum Outcome {
+            /// Answered, overloaded if slow.
+            ANSWERED,
+            /// No answer or rejected by the node.
+            DROPPED,
+            /// Cancelled, the limit is not changed.
+            IGNORED
+        };
+
+        ConcurrencyLimiter();
+
+        /// Enable the limiter with the settings, or disable it. Not while requests are in flight.
+        void configure(bool enabled, const Settings& settings);
+
+        /// Wait for a slot, within the deadline of the request. False if the request is cancelled or late.
+        bool acquire();
+
+        /// Give back the slot and adapt the limit to the outcome.
+        void release(Outcome outcome, std::chrono::microseconds latency);
+
+        /// Tells if no slot is free.
+        bool full() const;
+
+        /// Current limit.
+        unsigned int limit() const;
+
+    private:
+        std::atomic<bool> _enabled;
+
+        /// Read and written under the mutex.
+        Settings _settings;
+
+        mutable std::mutex _mutex;
+        std::condition_variable _released;
+        double _limit;
+        unsigned int _inflight;
+};
+
+#endif // LIMITER_H
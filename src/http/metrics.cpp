@@ -0,0 +1,98 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include "metrics.h"
+
+#include <cstring>
+
+HTTPMetrics::HTTPMetrics()
+: _connectionsOpened(0),
+  _connectionsReused(0),
+  _connectionsFailed(0),
+  _connectionsClosed(0),
+  _bytesSent(0),
+  _bytesReceived(0),
+  _writeCalls(0),
+  _readCalls(0),
+  _chunkedResponses(0),
+  _contentLengthResponses(0),
+  _otherResponses(0),
+  _retries(0)
+{
+    for(unsigned int i = 0; i < MethodCount; ++i)
+        _methods[i].store(0, std::memory_order_relaxed);
+
+    for(unsigned int i = 0; i < MaxStatusCode; ++i)
+        _statusCodes[i].store(0, std::memory_order_relaxed);
+}
+
+// A request was answered with the status code.
+void HTTPMetrics::request(const char* method, unsigned int statusCode) {
+    Method index = OTHER;
+    if(strcmp(method, "GET") == 0)
+        index = GET;
+    else if(strcmp(method, "HEAD") == 0)
+        index = HEAD;
+    else if(strcmp(method, "POST") == 0)
+        index = POST;
+    else if(strcmp(method, "PUT") == 0)
+        index = PUT;
+    else if(strcmp(method, "DELETE") == 0)
+        index = DELETE;
+
+    _methods[index].fetch_add(1, std::memory_order_relaxed);
+    _statusCodes[statusCode < MaxStatusCode ? statusCode : 0].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Values of the counters, each one read atomically but not all at once.
+HTTPStats HTTPMetrics::stats() const {
+    static const char* methods[] = { "GET", "HEAD", "POST", "PUT", "DELETE", "OTHER" };
+
+    HTTPStats stats;
+    stats.connectionsOpened = _connectionsOpened.load(std::memory_order_relaxed);
+    stats.connectionsReused = _connectionsReused.load(std::memory_order_relaxed);
+    stats.connectionsFailed = _connectionsFailed.load(std::memory_order_relaxed);
+    stats.connectionsClosed = _connectionsClosed.load(std::memory_order_relaxed);
+
+    for(unsigned int i = 0; i < MethodCount; ++i) {
+        uint64_t count = _methods[i].load(std::memory_order_relaxed);
+        if(count > 0)
+            stats.requestsByMethod[methods[i]] = count;
+    }
+
+    for(unsigned int i = 0; i < MaxStatusCode; ++i) {
+        uint64_t count = _statusCodes[i].load(std::memory_order_relaxed);
+        if(count > 0)
+            stats.requestsByStatus[i] = count;
+    }
+
+    stats.bytesSent = _bytesSent.load(std::memory_order_relaxed);
+    stats.bytesReceived = _bytesReceived.load(std::memory_order_relaxed);
+    stats.writeCalls = _writeCalls.load(std::memory_order_relaxed);
+    stats.readCalls = _readCalls.load(std::memory_order_relaxed);
+
+    stats.chunkedResponses = _chunkedResponses.load(std::memory_order_relaxed);
+    stats.contentLengthResponses = _contentLengthResponses.load(std::memory_order_relaxed);
+    stats.otherResponses = _otherResponses.load(std::memory_order_relaxed);
+
+    stats.retries = _retries.load(std::memory_order_relaxed);
+    return stats;
+}
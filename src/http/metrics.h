@@ -0,0 +1,117 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <cstdint>
+
+/// Values of the counters of the connections and the requests at one time.
+struct HTTPStats {
+    /// Connections opened, requests sent on an open connection, failed connections and closed connections.
+    uint64_t connectionsOpened;
+    uint64_t connectionsReused;
+    uint64_t connectionsFailed;
+    uint64_t connectionsClosed;
+
+    /// Requests by method and by status code of the response, 0 when there was no complete response.
+    std::map<std::string, uint64_t> requestsByMethod;
+    std::map<unsigned int, uint64_t> requestsByStatus;
+
+    /// Bytes on the wire, headers included, and the read and write system calls.
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    uint64_t writeCalls;
+    uint64_t readCalls;
+
+    /// Complete responses by the delimitation of their body, the others have no body or end with the connection.
+    uint64_t chunkedResponses;
+    uint64_t contentLengthResponses;
+    uint64_t otherResponses;
+
+    /// Requests sent again after a transient failure.
+    uint64_t retries;
+};
+
+/// Counters of the connections and the requests, shared by the connections of a pool. Lock free.
+class HTTPMetrics {
+    public:
+        HTTPMetrics();
+
+        inline void connectionOpened() { _connectionsOpened.fetch_add(1, std::memory_order_relaxed); }
+        inline void connectionReused() { _connectionsReused.fetch_add(1, std::memory_order_relaxed); }
+        inline void connectionFailed() { _connectionsFailed.fetch_add(1, std::memory_order_relaxed); }
+        inline void connectionClosed() { _connectionsClosed.fetch_add(1, std::memory_order_relaxed); }
+
+        /// A request was answered with the status code, 0 if not.
+        void request(const char* method, unsigned int statusCode);
+
+        /// One write or read system call and the bytes it transferred.
+        inline void written(size_t bytes) {
+            _writeCalls.fetch_add(1, std::memory_order_relaxed);
+            _bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        inline void read(size_t bytes) {
+            _readCalls.fetch_add(1, std::memory_order_relaxed);
+            _bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        /// A complete response was read.
+        inline void response(bool chunked, bool contentLength) {
+            (chunked ? _chunkedResponses : (contentLength ? _contentLengthResponses : _otherResponses)).fetch_add(1, std::memory_order_relaxed);
+        }
+
+        inline void retry() { _retries.fetch_add(1, std::memory_order_relaxed); }
+
+        /// Values of the counters.
+        HTTPStats stats() const;
+
+    private:
+        enum Method { GET, HEAD, POST, PUT, DELETE, OTHER, MethodCount };
+
+        /// Status codes above are counted as 0.
+        static const unsigned int MaxStatusCode = 600;
+
+        std::atomic<uint64_t> _connectionsOpened;
+        std::atomic<uint64_t> _connectionsReused;
+        std::atomic<uint64_t> _connectionsFailed;
+        std::atomic<uint64_t> _connectionsClosed;
+
+        std::atomic<uint64_t> _methods[MethodCount];
+        std::atomic<uint64_t> _statusCodes[MaxStatusCode];
+
+        std::atomic<uint64_t> _bytesSent;
+        std::atomic<uint64_t> _bytesReceived;
+        std::atomic<uint64_t> _writeCalls;
+        std::atomic<uint64_t> _readCalls;
+
+        std::atomic<uint64_t> _chunkedResponses;
+        std::atomic<uint64_t> _contentLengthResponses;
+        std::atomic<uint64_t> _otherResponses;
+
+        std::atomic<uint64_t> _retries;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,620 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "pool.h"
+#include "context.h"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <condition_variable>
+#include <sys/select.h>
+
+/// Longest time a node stays dead before being tried again.
+#define MAX_DEAD_BACKOFF_SECONDS 60
+
+Node::Node(const std::string& url, size_t maxIdle)
+: _url(url),
+  _maxIdle(maxIdle),
+  _outstanding(0),
+  _failures(0),
+  _deadUntil(0)
+{
+}
+
+Node::~Node() {
+    for(HTTP* http : _idle)
+        delete http;
+}
+
+// Take an idle connection or open a new one.
+HTTP* Node::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_idle.empty()) {
+            HTTP* http = _idle.back();
+            _idle.pop_back();
+            return http;
+        }
+    }
+
+    return new HTTP(_url, true);
+}
+
+// Give back a connection.
+void Node::release(HTTP* http, bool healthy) {
+    if(healthy) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_idle.size() < _maxIdle) {
+            _idle.push_back(http);
+            return;
+        }
+    }
+
+    delete http;
+}
+
+// Tells if the node may receive requests.
+bool Node::alive(Clock::time_point now) const {
+    return _deadUntil.load(std::memory_order_relaxed) <= now.time_since_epoch().count() && _breaker.available(now);
+}
+
+// Time until which the node is dead.
+Node::Clock::time_point Node::deadUntil() const {
+    return Clock::time_point(Clock::duration(_deadUntil.load(std::memory_order_relaxed)));
+}
+
+// Mark the node dead, the backoff doubles at each consecutive failure.
+void Node::markDead() {
+    unsigned int failures = std::min(++_failures, 7u);
+    std::chrono::seconds backoff(std::min(1 << (failures - 1), MAX_DEAD_BACKOFF_SECONDS));
+    _deadUntil.store((Clock::now() + backoff).time_since_epoch().count(), std::memory_order_relaxed);
+
+    // The idle connections of a dead node are likely broken too.
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(HTTP* http : _idle)
+        delete http;
+    _idle.clear();
+}
+
+// Mark the node alive after a successful request.
+void Node::markAlive() {
+    if(_failures.load(std::memory_order_relaxed) == 0)
+        return;
+
+    _failures.store(0, std::memory_order_relaxed);
+    _deadUntil.store(0, std::memory_order_relaxed);
+}
+
+ConnectionPool::ConnectionPool(const std::vector<std::string>& urls, Selection selection, size_t maxIdlePerNode)
+: _selection(selection),
+  _maxIdlePerNode(maxIdlePerNode),
+  _next(0),
+  _compressionThreshold(0),
+  _acceptEncoding(false),
+  _breakerEnabled(false),
+  _limiterEnabled(false),
+  _metrics(std::make_shared<HTTPMetrics>())
+{
+    if(urls.empty())
+        EXCEPTION("Connection pool needs at least one node.");
+
+    std::shared_ptr<Settings> settings = std::make_shared<Settings>();
+    settings->retryPolicy = std::make_shared<RetryPolicy>();
+    _settings = settings;
+
+    setNodes(urls);
+}
+
+ConnectionPool::~ConnectionPool() {
+}
+
+// Replace the nodes, the connections of the nodes kept are preserved.
+void ConnectionPool::setNodes(const std::vector<std::string>& urls) {
+    std::lock_guard<std::mutex> lock(_nodesMutex);
+
+    std::shared_ptr<const NodeList> current = std::atomic_load(&_nodes);
+    std::shared_ptr<NodeList> nodes = std::make_shared<NodeList>();
+
+    for(const std::string& url : urls) {
+        std::shared_ptr<Node> node;
+
+        if(current) {
+            for(const std::shared_ptr<Node>& n : *current) {
+                if(n->url() == url) {
+                    node = n;
+                    break;
+                }
+            }
+        }
+
+        if(!node)
+            node = makeNode(url);
+
+        nodes->push_back(node);
+    }
+
+    // Requests in flight keep their node alive until they release it.
+    std::atomic_store(&_nodes, std::shared_ptr<const NodeList>(nodes));
+}
+
+// Urls of the current nodes.
+std::vector<std::string> ConnectionPool::nodes() const {
+    std::shared_ptr<const NodeList> nodes = std::atomic_load(&_nodes);
+
+    std::vector<std::string> urls;
+    for(const std::shared_ptr<Node>& node : *nodes)
+        urls.push_back(node->url());
+
+    return urls;
+}
+
+// Choose the node of the next request, another one than avoid if possible.
+std::shared_ptr<Node> ConnectionPool::select(const Node* avoid) {
+    std::shared_ptr<const NodeList> nodes = std::atomic_load(&_nodes);
+    assert(!nodes->empty());
+
+    size_t size = nodes->size();
+    size_t start = _next.fetch_add(1, std::memory_order_relaxed) % size;
+    Node::Clock::time_point now = Node::Clock::now();
+
+    std::shared_ptr<Node> selected;
+    std::shared_ptr<Node> saturated;
+    for(size_t i = 0; i < size; ++i) {
+        const std::shared_ptr<Node>& node = (*nodes)[(start + i) % size];
+
+        if(!node->alive(now) || node.get() == avoid)
+            continue;
+
+        // A node at its concurrency limit is the last resort.
+        if(node->_limiter.full()) {
+            if(!saturated)
+                saturated = node;
+            continue;
+        }
+
+        if(_selection == ROUND_ROBIN)
+            return node;
+
+        if(!selected || node->outstanding() < selected->outstanding())
+            selected = node;
+    }
+
+    if(selected)
+        return selected;
+
+    if(saturated)
+        return saturated;
+
+    // The node to avoid is the only one alive.
+    for(const std::shared_ptr<Node>& node : *nodes)
+        if(node.get() == avoid && node->alive(now))
+            return node;
+
+    // All nodes are dead, try the one that is the closest to be retried.
+    selected = (*nodes)[start];
+    for(const std::shared_ptr<Node>& node : *nodes)
+        if(node->deadUntil() < selected->deadUntil())
+            selected = node;
+
+    return selected;
+}
+
+// Node of the url, created out of the balanced nodes if unknown.
+std::shared_ptr<Node> ConnectionPool::find(const std::string& url) {
+    std::shared_ptr<const NodeList> nodes = std::atomic_load(&_nodes);
+    for(const std::shared_ptr<Node>& node : *nodes)
+        if(node->url() == url)
+            return node;
+
+    std::lock_guard<std::mutex> lock(_nodesMutex);
+    std::shared_ptr<Node>& node = _directNodes[url];
+    if(!node)
+        node = makeNode(url);
+
+    return node;
+}
+
+// New node configured with the settings of the pool.
+std::shared_ptr<Node> ConnectionPool::makeNode(const std::string& url) const {
+    std::shared_ptr<Node> node = std::make_shared<Node>(url, _maxIdlePerNode);
+    node->_breaker.configure(_breakerEnabled, _breakerSettings);
+    node->_limiter.configure(_limiterEnabled, _limiterSettings);
+    return node;
+}
+
+// Apply the breaker and limiter settings to every node, under the nodes mutex.
+void ConnectionPool::configureNodes() {
+    for(const std::shared_ptr<Node>& node : *std::atomic_load(&_nodes)) {
+        node->_breaker.configure(_breakerEnabled, _breakerSettings);
+        node->_limiter.configure(_limiterEnabled, _limiterSettings);
+    }
+
+    for(const auto& direct : _directNodes) {
+        direct.second->_breaker.configure(_breakerEnabled, _breakerSettings);
+        direct.second->_limiter.configure(_limiterEnabled, _limiterSettings);
+    }
+}
+
+// Open the circuit breaker of a node when too many of its requests fail or are slow.
+void ConnectionPool::setCircuitBreaker(bool enabled, const CircuitBreaker::Settings& settings) {
+    std::lock_guard<std::mutex> lock(_nodesMutex);
+
+    _breakerEnabled = enabled;
+    _breakerSettings = settings;
+    configureNodes();
+}
+
+// Limit the requests in flight on each node with an adaptive limit.
+void ConnectionPool::setConcurrencyLimiter(bool enabled, const ConcurrencyLimiter::Settings& settings) {
+    std::lock_guard<std::mutex> lock(_nodesMutex);
+
+    _limiterEnabled = enabled;
+    _limiterSettings = settings;
+    configureNodes();
+}
+
+// Compress the request bodies from the given size and accept compressed responses.
+void ConnectionPool::setCompression(size_t threshold, bool acceptEncoding) {
+    _compressionThreshold.store(threshold, std::memory_order_relaxed);
+    _acceptEncoding.store(acceptEncoding, std::memory_order_relaxed);
+}
+
+// Replace the settings of the requests with a copy changed by update.
+template<typename Update>
+void ConnectionPool::updateSettings(Update update) {
+    std::lock_guard<std::mutex> lock(_settingsMutex);
+
+    std::shared_ptr<Settings> settings = std::make_shared<Settings>(*std::atomic_load(&_settings));
+    update(*settings);
+
+    // Requests in flight keep the settings they started with.
+    std::atomic_store(&_settings, std::shared_ptr<const Settings>(settings));
+}
+
+// Timeouts of every connection.
+void ConnectionPool::setTimeouts(const Timeouts& timeouts) {
+    updateSettings([&timeouts](Settings& settings){ settings.timeouts = timeouts; });
+}
+
+// Current timeouts.
+Timeouts ConnectionPool::timeouts() const {
+    return settings()->timeouts;
+}
+
+// Options of the sockets of every connection.
+void ConnectionPool::setSocketOptions(const SocketOptions& options) {
+    updateSettings([&options](Settings& settings){ settings.socketOptions = options; });
+}
+
+// Hook following every request of every connection.
+void ConnectionPool::setTraceHook(const std::shared_ptr<TraceHook>& hook) {
+    updateSettings([&hook](Settings& settings){ settings.traceHook = hook; });
+}
+
+// Policy of the retries of the failed requests.
+void ConnectionPool::setRetryPolicy(const std::shared_ptr<const RetryPolicy>& policy) {
+    updateSettings([&policy](Settings& settings){ settings.retryPolicy = policy ? policy : std::make_shared<RetryPolicy>(1); });
+}
+
+// Hedge the requests after the latency at percentile of the recent ones.
+void ConnectionPool::setHedging(double percentile, std::chrono::milliseconds initialDelay) {
+    updateSettings([percentile, initialDelay](Settings& settings){
+        if(percentile <= 0.0) {
+            settings.hedgingLatency.reset();
+            settings.hedger.reset();
+            return;
+        }
+
+        // The hedged requests in flight keep the previous tracker and scheduler until they are over.
+        settings.hedgingLatency = std::make_shared<LatencyTracker>(percentile, initialDelay);
+        if(!settings.hedger)
+            settings.hedger = std::make_shared<Scheduler>();
+    });
+}
+
+// Deadline of an operation from the default request timeout, none if zero.
+static RequestContext::Clock::time_point defaultDeadline(const Timeouts& timeouts) {
+    if(timeouts.request.count() <= 0)
+        return RequestContext::Clock::time_point::max();
+
+    return RequestContext::Clock::now() + timeouts.request;
+}
+
+// Clear the partial output of a failed attempt.
+static void clearOutput(Json::Object* root) {
+    if(root)
+        root->clear();
+}
+
+static void clearOutput(std::string& output) {
+    output.clear();
+}
+
+// Sleep before a retry, false if the request is cancelled or the deadline is before the end of the delay.
+static bool sleepBeforeRetry(std::chrono::milliseconds delay) {
+    const RequestContext& context = RequestContext::current();
+
+    if(context.hasDeadline() && RequestContext::Clock::now() + delay >= context.deadline())
+        return false;
+
+    CancellationToken* token = context.token();
+    if(!token) {
+        std::this_thread::sleep_for(delay);
+        return true;
+    }
+
+    // Wake up on cancellation.
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(token->fd(), &readSet);
+
+    timeval tval;
+    tval.tv_sec = delay.count() / 1000;
+    tval.tv_usec = (delay.count() % 1000) * 1000;
+    ::select(token->fd() + 1, &readSet, 0, 0, &tval);
+
+    return !token->cancelled();
+}
+
+// Run the request, retried on another node after a transient failure if the policy allows it.
+template<typename Output>
+unsigned int ConnectionPool::execute(std::shared_ptr<Node> node, const char* method, const char* endUrl, const char* data, Output& output, Result& result, const char* content_type) {
+
+    // One default deadline for the whole operation, the retries do not get a fresh one, and it is still
+    // installed when a late attempt throws, so the node is not blamed.
+    std::shared_ptr<const Settings> settings = this->settings();
+    RequestContext::Scope scope(defaultDeadline(settings->timeouts));
+
+    const RetryPolicy* policy = settings->retryPolicy.get();
+    unsigned int maxAttempts = policy->retryable(method, endUrl) ? policy->maxAttempts() : 1;
+
+    for(unsigned int attempt = 1; ; ++attempt) {
+        bool last = (attempt >= maxAttempts);
+        unsigned int statusCode = 0;
+
+        try {
+            statusCode = send(*settings, node, method, endUrl, data, output, result, content_type);
+        }
+        catch(Exception&) {
+            // Connection refused or reset, never retry a cancelled or late request.
+            if(last || RequestContext::current().aborted())
+                throw;
+        }
+
+        if(last || !policy->transient(statusCode))
+            return statusCode;
+
+        if(!sleepBeforeRetry(policy->backoff(attempt)))
+            return statusCode;
+
+        clearOutput(output);
+        node = select(node.get());
+        _metrics->retry();
+    }
+}
+
+// Run the request on a connection leased from the node.
+template<typename Output>
+unsigned int ConnectionPool::send(const Settings& settings, const std::shared_ptr<Node>& node, const char* method, const char* endUrl, const char* data, Output& output, Result& result, const char* content_type) {
+
+    // Fail fast on an overloaded node, the retry policy may choose another one.
+    if(!node->_breaker.allow())
+        EXCEPTION("Circuit breaker open on node " + node->url() + ".");
+
+    if(!node->_limiter.acquire()) {
+        node->_breaker.cancel();
+        EXCEPTION("Request aborted while waiting for a free slot on node " + node->url() + ".");
+    }
+
+    Node::Clock::time_point start = Node::Clock::now();
+
+    ++node->_outstanding;
+    HTTP* http = 0;
+
+    unsigned int statusCode = 0;
+    try {
+        http = node->acquire();
+        http->setCompression(_compressionThreshold.load(std::memory_order_relaxed), _acceptEncoding.load(std::memory_order_relaxed));
+        http->setTimeouts(settings.timeouts);
+        http->setSocketOptions(settings.socketOptions);
+        http->setMetrics(_metrics);
+        http->setTraceHook(settings.traceHook);
+        statusCode = http->request(method, endUrl, data, output, result, content_type);
+    }
+    catch(...) {
+        --node->_outstanding;
+        std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(Node::Clock::now() - start);
+
+        // A cancelled or late request says nothing about the node.
+        if(!RequestContext::current().aborted()) {
+            node->markDead();
+            node->_breaker.record(false, latency);
+            node->_limiter.release(ConcurrencyLimiter::DROPPED, latency);
+        } else {
+            node->_breaker.cancel();
+            node->_limiter.release(ConcurrencyLimiter::IGNORED, latency);
+        }
+
+        if(http)
+            node->release(http, false);
+        throw;
+    }
+
+    --node->_outstanding;
+    std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(Node::Clock::now() - start);
+
+    // Rejections and gateway errors are overload signals, as no answer.
+    bool overloaded = (statusCode == 0 || statusCode == 429 || statusCode == 503 || statusCode == 504);
+    node->_limiter.release(overloaded ? ConcurrencyLimiter::DROPPED : ConcurrencyLimiter::ANSWERED, latency);
+    node->_breaker.record(statusCode != 0 && statusCode != 429 && statusCode < 500, latency);
+
+    // No status code means the node did not answer.
+    if(statusCode == 0) {
+        node->markDead();
+        node->release(http, false);
+        return statusCode;
+    }
+
+    node->markAlive();
+    node->release(http, true);
+    return statusCode;
+}
+
+// Generic request on one node that parses the result in Json::Object.
+unsigned int ConnectionPool::request(const char* method, const char* endUrl, const char* data, Json::Object* root, Result& result, const char* content_type) {
+    return execute(select(), method, endUrl, data, root, result, content_type);
+}
+
+// Generic request on the node of the given url if alive, on any node otherwise.
+unsigned int ConnectionPool::request(const std::string& url, const char* method, const char* endUrl, const char* data, Json::Object* root, Result& result, const char* content_type) {
+    if(url.empty())
+        return execute(select(), method, endUrl, data, root, result, content_type);
+
+    std::shared_ptr<Node> node = find(url);
+    if(!node->alive(Node::Clock::now()))
+        node = select();
+
+    return execute(node, method, endUrl, data, root, result, content_type);
+}
+
+// Generic read request duplicated on another node when no answer came within the hedging delay.
+unsigned int ConnectionPool::hedgedRequest(const std::string& url, const char* method, const char* endUrl, const char* data, Json::Object* root, Result& result, const char* content_type) {
+    std::shared_ptr<const Settings> settings = this->settings();
+    if(!settings->hedgingLatency)
+        return request(url, method, endUrl, data, root, result, content_type);
+
+    // The default deadline bounds both attempts.
+    RequestContext::Scope scope(defaultDeadline(settings->timeouts));
+
+    std::shared_ptr<Node> node = url.empty() ? select() : find(url);
+    if(!node->alive(Node::Clock::now()))
+        node = select();
+
+    // One attempt of the request, each with its own output.
+    struct Attempt {
+        Attempt() : result(ERROR), statusCode(0), done(false) {}
+
+        Json::Object output;
+        Result result;
+        unsigned int statusCode;
+        std::exception_ptr error;
+        bool done;
+    };
+
+    const RequestContext& context = RequestContext::current();
+    RequestContext::Clock::time_point deadline = context.deadline();
+    RequestContext::Clock::time_point start = RequestContext::Clock::now();
+    const CancellationToken* parent = context.token();
+
+    Attempt primary;
+    Attempt hedge;
+
+    // The primary must be cancellable from the start, its token borrows the pipe of the thread
+    // so a hedged read that is not hedged creates no pipe.
+    CancellationToken primaryToken(parent, CancellationToken::THREAD_PIPE);
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    CancellationToken* hedgeToken = 0;
+    Attempt* winner = 0;
+
+    // The hedge races the primary on another node if it did not answer within the delay. Its token
+    // is only created when it fires, on the pipe of the worker.
+    Scheduler& hedger = *settings->hedger;
+    Scheduler::Task task = hedger.schedule(start + settings->hedgingLatency->percentile(), [&]{
+        std::unique_ptr<CancellationToken> token;
+        try {
+            token.reset(new CancellationToken(parent, CancellationToken::THREAD_PIPE));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(!primary.done)
+                    hedgeToken = token.get();
+            }
+
+            if(hedgeToken) {
+                RequestContext::Scope scope(deadline, token.get());
+                Json::Object* output = &hedge.output;
+                hedge.statusCode = execute(select(node.get()), method, endUrl, data, output, hedge.result, content_type);
+            }
+        }
+        catch(...) {
+            hedge.error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        hedge.done = true;
+        if(!winner && hedgeToken && !hedge.error && hedge.statusCode != 0) {
+            winner = &hedge;
+            primaryToken.cancel();
+        }
+        hedgeToken = 0;
+        finished.notify_all();
+    });
+
+    {
+        RequestContext::Scope scope(primaryToken);
+        Json::Object* output = &primary.output;
+        try {
+            primary.statusCode = execute(node, method, endUrl, data, output, primary.result, content_type);
+        }
+        catch(...) {
+            primary.error = std::current_exception();
+        }
+    }
+
+    // Cut short by a winning hedge, the latency is still a lower bound of the primary one.
+    std::chrono::microseconds primaryLatency = std::chrono::duration_cast<std::chrono::microseconds>(RequestContext::Clock::now() - start);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        primary.done = true;
+        if(!winner && !primary.error && primary.statusCode != 0) {
+            winner = &primary;
+            if(hedgeToken)
+                hedgeToken->cancel();
+        }
+
+        // A hedge that started uses this frame, wait for it, cancelled if the primary answered.
+        if(!hedger.cancel(task))
+            finished.wait(lock, [&hedge]{ return hedge.done; });
+    }
+
+    if(!winner) {
+        if(primary.error)
+            std::rethrow_exception(primary.error);
+        winner = &primary;
+    }
+    else {
+        // Only the latency of the primary, a fast hedge would lower the delay and fire even more hedges.
+        settings->hedgingLatency->record(primaryLatency);
+    }
+
+    if(root)
+        root->append(winner->output);
+
+    result = winner->result;
+    return winner->statusCode;
+}
+
+// Generic request on one node that stores result in the string.
+unsigned int ConnectionPool::request(const char* method, const char* endUrl, const char* data, std::string& output, Result& result, const char* content_type) {
+    return execute(select(), method, endUrl, data, output, result, content_type);
+}
@@ -0,0 +1,275 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <map>
+
+#include "http.h"
+#include "retry.h"
+#include "latency.h"
+#include "scheduler.h"
+#include "breaker.h"
+#include "limiter.h"
+#include "metrics.h"
+
+/// Node of the cluster: a coordinating node url with its idle keep-alive connections.
+/// A node that failed to answer is dead until its backoff expires, then it is tried again.
+/// Its circuit breaker and concurrency limiter protect it when it is overloaded.
+class Node {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        Node(const std::string& url, size_t maxIdle);
+        ~Node();
+
+        /// Url of the node as given to HTTP.
+        const std::string& url() const { return _url; }
+
+        /// Take an idle connection or open a new one. The caller owns it until release.
+        HTTP* acquire();
+
+        /// Give back a connection, kept for reuse if healthy and the idle list is not full.
+        void release(HTTP* http, bool healthy);
+
+        /// Number of requests in flight on this node.
+        unsigned int outstanding() const { return _outstanding.load(std::memory_order_relaxed); }
+
+        /// Tells if the node may receive requests, neither dead nor with an open circuit breaker.
+        bool alive(Clock::time_point now) const;
+
+        /// Time until which the node is dead.
+        Clock::time_point deadUntil() const;
+
+        /// Mark the node dead, the backoff doubles at each consecutive failure.
+        void markDead();
+
+        /// Mark the node alive after a successful request.
+        void markAlive();
+
+    private:
+        friend class ConnectionPool;
+
+        std::string _url;
+
+        /// Idle keep-alive connections.
+        std::vector<HTTP*> _idle;
+        size_t _maxIdle;
+        std::mutex _mutex;
+
+        std::atomic<unsigned int> _outstanding;
+        std::atomic<unsigned int> _failures;
+
+        /// Dead until this time since the clock epoch, 0 if alive.
+        std::atomic<Clock::rep> _deadUntil;
+
+        /// Trips on error rate or latency.
+        CircuitBreaker _breaker;
+
+        /// Adaptive limit of the requests in flight.
+        ConcurrencyLimiter _limiter;
+};
+
+/// Pool of connections over many nodes of the cluster, with the same request interface as HTTP.
+/// Every request leases a connection of one node, chosen round-robin or by least outstanding requests.
+class ConnectionPool {
+    public:
+        enum Selection {
+            ROUND_ROBIN,
+            LEAST_LOADED
+        };
+
+        ConnectionPool(const std::vector<std::string>& urls, Selection selection = ROUND_ROBIN, size_t maxIdlePerNode = 32);
+        ~ConnectionPool();
+
+        /// Generic request on one node that parses the result in Json::Object.
+        unsigned int request(const char* method, const char* endUrl, const char* data, Json::Object* root, Result& result, const char* content_type = _APPLICATION_JSON);
+
+        /// Generic request on one node that stores result in the string.
+        unsigned int request(const char* method, const char* endUrl, const char* data, std::string& output, Result& result, const char* content_type = _APPLICATION_JSON);
+
+        /// Generic request on the node of the given url if alive, on any node otherwise. The node may be out of the balanced ones.
+        unsigned int request(const std::string& node, const char* method, const char* endUrl, const char* data, Json::Object* root, Result& result, const char* content_type = _APPLICATION_JSON);
+
+        /// Generic read request on the node of the given url (any node if empty), duplicated on another node or connection
+        /// when no answer came within the hedging delay. The first answer wins, the other request is cancelled.
+        /// Behaves as request if hedging is disabled. Only for requests without side effect.
+        unsigned int hedgedRequest(const std::string& node, const char* method, const char* endUrl, const char* data, Json::Object* root, Result& result, const char* content_type = _APPLICATION_JSON);
+
+        /// Generic get request to one node.
+        inline unsigned int get(const char* endUrl, const char* data, Json::Object* root){
+            Result result;
+            return request("GET", endUrl, data, root, result);
+        }
+
+        /// Generic head request to one node.
+        inline unsigned int head(const char* endUrl, const char* data, Json::Object* root){
+            Result result;
+            return request("HEAD", endUrl, data, root, result);
+        }
+
+        /// Generic put request to one node.
+        inline unsigned int put(const char* endUrl, const char* data, Json::Object* root){
+            Result result;
+            return request("PUT", endUrl, data, root, result);
+        }
+
+        /// Generic post request to one node.
+        inline unsigned int post(const char* endUrl, const char* data, Json::Object* root){
+            Result result;
+            return request("POST", endUrl, data, root, result);
+        }
+
+        /// Generic delete request to one node.
+        inline unsigned int remove(const char* endUrl, const char* data, Json::Object* root){
+            Result result;
+            return request("DELETE", endUrl, data, root, result);
+        }
+
+        /// Replace the nodes, the connections of the nodes kept are preserved.
+        void setNodes(const std::vector<std::string>& urls);
+
+        /// Urls of the current nodes.
+        std::vector<std::string> nodes() const;
+
+        /// Compress the request bodies from the given size, 0 to disable, and accept compressed responses.
+        void setCompression(size_t threshold, bool acceptEncoding);
+
+        /// Timeouts of every connection. The setters below may be called while requests are in flight,
+        /// each request keeps the settings it started with.
+        void setTimeouts(const Timeouts& timeouts);
+
+        /// Current timeouts.
+        Timeouts timeouts() const;
+
+        /// Options of the sockets of every connection.
+        void setSocketOptions(const SocketOptions& options);
+
+        /// Hook following every request of every connection, null for none.
+        void setTraceHook(const std::shared_ptr<TraceHook>& hook);
+
+        /// Policy of the retries of the failed requests, null disables them.
+        void setRetryPolicy(const std::shared_ptr<const RetryPolicy>& policy);
+
+        /// Open the circuit breaker of a node when too many of its requests fail or are slow. Disabled by default.
+        void setCircuitBreaker(bool enabled, const CircuitBreaker::Settings& settings = CircuitBreaker::Settings());
+
+        /// Limit the requests in flight on each node with an adaptive (AIMD) limit, the requests over it wait for a slot.
+        /// Disabled by default.
+        void setConcurrencyLimiter(bool enabled, const ConcurrencyLimiter::Settings& settings = ConcurrencyLimiter::Settings());
+
+        /// Hedge the requests sent with hedgedRequest after the latency at percentile (0.95 for p95) of the recent ones,
+        /// initialDelay until enough requests are measured. A zero percentile disables it.
+        void setHedging(double percentile, std::chrono::milliseconds initialDelay);
+
+        /// Counters of the connections and the requests of every node.
+        inline HTTPStats stats() const { return _metrics->stats(); }
+
+    private:
+        typedef std::vector< std::shared_ptr<Node> > NodeList;
+
+        /// Settings of the requests, replaced as a whole so a request reads them once, consistent.
+        struct Settings {
+            Timeouts timeouts;
+            SocketOptions socketOptions;
+
+            /// Retries of the failed requests.
+            std::shared_ptr<const RetryPolicy> retryPolicy;
+
+            /// Hook shared by every connection, null if none.
+            std::shared_ptr<TraceHook> traceHook;
+
+            /// Latencies of the hedged requests, null if hedging is disabled.
+            std::shared_ptr<LatencyTracker> hedgingLatency;
+
+            /// Fires the hedges on long-lived threads, null if hedging is disabled.
+            std::shared_ptr<Scheduler> hedger;
+        };
+
+        /// Current settings of the requests.
+        inline std::shared_ptr<const Settings> settings() const { return std::atomic_load(&_settings); }
+
+        /// Replace the settings of the requests with a copy changed by update.
+        template<typename Update>
+        void updateSettings(Update update);
+
+        /// Choose the node of the next request, another one than avoid if possible.
+        std::shared_ptr<Node> select(const Node* avoid = 0);
+
+        /// Node of the url, created out of the balanced nodes if unknown.
+        std::shared_ptr<Node> find(const std::string& url);
+
+        /// New node configured with the settings of the pool.
+        std::shared_ptr<Node> makeNode(const std::string& url) const;
+
+        /// Apply the breaker and limiter settings to every node.
+        void configureNodes();
+
+        /// Run the request, retried on another node after a transient failure if the policy allows it.
+        template<typename Output>
+        unsigned int execute(std::shared_ptr<Node> node, const char* method, const char* endUrl, const char* data, Output& output, Result& result, const char* content_type);
+
+        /// Run the request on a connection leased from the node.
+        template<typename Output>
+        unsigned int send(const Settings& settings, const std::shared_ptr<Node>& node, const char* method, const char* endUrl, const char* data, Output& output, Result& result, const char* content_type);
+
+        /// Current nodes, replaced as a whole.
+        std::shared_ptr<const NodeList> _nodes;
+
+        /// Serialize the node list updates.
+        mutable std::mutex _nodesMutex;
+
+        /// Nodes targeted directly but not balanced, by url.
+        std::map< std::string, std::shared_ptr<Node> > _directNodes;
+
+        Selection _selection;
+        size_t _maxIdlePerNode;
+
+        /// Round-robin counter.
+        std::atomic<size_t> _next;
+
+        /// Compression applied to every leased connection.
+        std::atomic<size_t> _compressionThreshold;
+        std::atomic<bool> _acceptEncoding;
+
+        /// Settings of the requests, read without lock.
+        std::shared_ptr<const Settings> _settings;
+
+        /// Serialize the settings updates.
+        std::mutex _settingsMutex;
+
+        /// Settings of the breaker and limiter of every node, under the nodes mutex.
+        bool _breakerEnabled;
+        CircuitBreaker::Settings _breakerSettings;
+        bool _limiterEnabled;
+        ConcurrencyLimiter::Settings _limiterSettings;
+
+        /// Counters shared by every connection.
+        std::shared_ptr<HTTPMetrics> _metrics;
+};
+
+#endif // POOL_H
@@ -0,0 +1,159 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "resolver.h"
+#include "context.h"
+#include "http.h"
+
+#include <thread>
+#include <cstring>
+#include <netdb.h>
+
+/// Longest wait between two checks of the cancellation of a request waiting for a resolution.
+#define RESOLVER_POLL_MILLISECONDS 10
+
+Resolver::Resolver()
+: _ttl(60) {
+}
+
+// Process wide resolver, never destroyed so background resolutions may outlive main.
+Resolver& Resolver::instance() {
+    static Resolver* resolver = new Resolver;
+    return *resolver;
+}
+
+// Time before resolving a host again.
+void Resolver::setTTL(std::chrono::seconds ttl) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _ttl = ttl;
+}
+
+// Entry of the host, created if unknown.
+std::shared_ptr<Resolver::Entry> Resolver::entry(const std::string& host, int port) {
+    std::string key = host + ":" + std::to_string(port);
+
+    std::shared_ptr<Entry>& entry = _entries[key];
+    if(!entry)
+        entry = std::make_shared<Entry>();
+
+    return entry;
+}
+
+// Start resolving the host in background if not cached yet.
+void Resolver::prefetch(const std::string& host, int port) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::shared_ptr<Entry> e = entry(host, port);
+    if(!e->addresses || e->expire <= Clock::now())
+        refresh(e, host, port);
+}
+
+// Resolve the host in background if not already running.
+void Resolver::refresh(const std::shared_ptr<Entry>& entry, const std::string& host, int port) {
+    if(entry->resolving)
+        return;
+
+    entry->resolving = true;
+
+    std::thread([this, entry, host, port]{
+        std::string error;
+        std::shared_ptr<const Addresses> addresses = lookup(host, port, error);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Keep the previous addresses if the host cannot be resolved anymore.
+        if(addresses)
+            entry->addresses = addresses;
+
+        entry->error = error;
+        entry->expire = Clock::now() + _ttl;
+        entry->resolving = false;
+        _resolved.notify_all();
+    }).detach();
+}
+
+// Addresses of the host.
+Resolver::Resolution Resolver::resolve(const std::string& host, int port) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    std::shared_ptr<Entry> e = entry(host, port);
+
+    if(!e->addresses || e->expire <= Clock::now())
+        refresh(e, host, port);
+
+    // Only the first resolution is waited for, within the deadline of the request. The token has no
+    // condition to wait on, it is checked every few milliseconds.
+    const RequestContext& context = RequestContext::current();
+    while(!e->addresses && e->resolving) {
+        if(context.cancelled())
+            EXCEPTION("Request cancelled.");
+
+        if(context.expired())
+            EXCEPTION("Request deadline exceeded.");
+
+        _resolved.wait_for(lock, context.remaining(std::chrono::milliseconds(RESOLVER_POLL_MILLISECONDS)));
+    }
+
+    if(!e->addresses)
+        EXCEPTION("Error retrieving DNS information: " + e->error);
+
+    Resolution resolution;
+    resolution.addresses = e->addresses;
+    resolution.next = e->next.fetch_add(1, std::memory_order_relaxed);
+    return resolution;
+}
+
+// Blocking resolution with getaddrinfo.
+std::shared_ptr<const Resolver::Addresses> Resolver::lookup(const std::string& host, int port, std::string& error) {
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    struct addrinfo* result = 0;
+    int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+    if(status != 0) {
+        error = gai_strerror(status);
+        return std::shared_ptr<const Addresses>();
+    }
+
+    std::shared_ptr<Addresses> addresses = std::make_shared<Addresses>();
+    for(struct addrinfo* info = result; info != 0; info = info->ai_next) {
+        if(info->ai_addrlen > sizeof(struct sockaddr_storage))
+            continue;
+
+        Address address;
+        memset(&address.storage, 0, sizeof(address.storage));
+        memcpy(&address.storage, info->ai_addr, info->ai_addrlen);
+        address.length = info->ai_addrlen;
+        addresses->push_back(address);
+    }
+
+    freeaddrinfo(result);
+
+    if(addresses->empty()) {
+        error = "no address";
+        return std::shared_ptr<const Addresses>();
+    }
+
+    return addresses;
+}
@@ -0,0 +1,97 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/// Socket address of a host, IPv4 or IPv6.
+struct Address {
+    struct sockaddr_storage storage;
+    socklen_t length;
+};
+
+/// Cache of host resolutions with getaddrinfo.
+/// Resolutions run on a background thread: only the first connection to a host waits for it,
+/// an expired entry is still used while it is resolved again.
+class Resolver {
+    public:
+        typedef std::vector<Address> Addresses;
+
+        /// Addresses of a host and the one the next connection should start with.
+        struct Resolution {
+            std::shared_ptr<const Addresses> addresses;
+            size_t next;
+        };
+
+        /// Process wide resolver.
+        static Resolver& instance();
+
+        /// Start resolving the host in background if not cached yet.
+        void prefetch(const std::string& host, int port);
+
+        /// Addresses of the host, successive calls start with successive addresses. Throws if the host cannot be resolved,
+        /// or if the request is cancelled or over its deadline while the first resolution runs.
+        Resolution resolve(const std::string& host, int port);
+
+        /// Time before resolving a host again.
+        void setTTL(std::chrono::seconds ttl);
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        Resolver();
+
+        struct Entry {
+            std::shared_ptr<const Addresses> addresses;
+            std::string error;
+            bool resolving;
+            Clock::time_point expire;
+            std::atomic<size_t> next;
+
+            Entry(): resolving(false), next(0) {}
+        };
+
+        /// Entry of the host, created if unknown. Requires the lock.
+        std::shared_ptr<Entry> entry(const std::string& host, int port);
+
+        /// Resolve the host in background if not already running. Requires the lock.
+        void refresh(const std::shared_ptr<Entry>& entry, const std::string& host, int port);
+
+        /// Blocking resolution with getaddrinfo.
+        static std::shared_ptr<const Addresses> lookup(const std::string& host, int port, std::string& error);
+
+        std::map< std::string, std::shared_ptr<Entry> > _entries;
+        std::chrono::seconds _ttl;
+        std::mutex _mutex;
+        std::condition_variable _resolved;
+};
+
+#endif // RESOLVER_H
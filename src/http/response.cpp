@@ -0,0 +1,346 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "response.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <zlib.h>
+
+/// Size of the buffer receiving the inflated body.
+#define INFLATE_BUFFER_SIZE 16384
+
+/// Longest status, header or chunk size line accepted.
+#define MAX_LINE_SIZE 65536
+
+ResponseReader::ResponseReader(std::string& output, bool head)
+: _output(output),
+  _state(STATUS_LINE),
+  _head(head),
+  _statusCode(0),
+  _keepAlive(true),
+  _chunked(false),
+  _hasLength(false),
+  _remaining(0),
+  _received(0),
+  _inflate(0),
+  _inflateEnd(false)
+{
+}
+
+ResponseReader::~ResponseReader() {
+    if(_inflate) {
+        inflateEnd(_inflate);
+        delete _inflate;
+    }
+}
+
+// Read one line ending with \r\n.
+bool ResponseReader::readLine(const char*& data, const char* end) {
+    const char* endLine = static_cast<const char*>(memchr(data, '\n', end - data));
+
+    if(endLine == 0) {
+        _line.append(data, end - data);
+        data = end;
+        return false;
+    }
+
+    _line.append(data, endLine - data);
+    data = endLine + 1;
+
+    if(!_line.empty() && _line[_line.size() - 1] == '\r')
+        _line.resize(_line.size() - 1);
+
+    return true;
+}
+
+// Interpret the status line, as "HTTP/1.1 200 OK".
+bool ResponseReader::parseStatus() {
+    if(_line.compare(0, 5, "HTTP/") != 0)
+        return false;
+
+    size_t pos = _line.find(' ');
+    if(pos == std::string::npos)
+        return false;
+
+    char* endCode;
+    unsigned long code = strtoul(_line.c_str() + pos + 1, &endCode, 10);
+    if(endCode == _line.c_str() + pos + 1 || code < 100 || code > 999)
+        return false;
+
+    _statusCode = code;
+
+    // HTTP/1.0 closes the connection by default.
+    _keepAlive = (_line.compare(0, 8, "HTTP/1.0") != 0);
+
+    return true;
+}
+
+// Interpret one header line, the names are case insensitive.
+bool ResponseReader::parseHeader() {
+    size_t colon = _line.find(':');
+    if(colon == std::string::npos)
+        return false;
+
+    std::string name = _line.substr(0, colon);
+
+    size_t start = _line.find_first_not_of(" \t", colon + 1);
+    std::string value = (start == std::string::npos) ? std::string() : _line.substr(start);
+
+    size_t last = value.find_last_not_of(" \t");
+    value.resize(last == std::string::npos ? 0 : last + 1);
+
+    if(strcasecmp(name.c_str(), "Content-Length") == 0) {
+        char* endLength;
+        _remaining = strtoull(value.c_str(), &endLength, 10);
+        if(endLength == value.c_str())
+            return false;
+        _hasLength = true;
+    }
+    else if(strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+        _chunked = (strcasestr(value.c_str(), "chunked") != 0);
+    }
+    else if(strcasecmp(name.c_str(), "Connection") == 0) {
+        if(strcasecmp(value.c_str(), "close") == 0)
+            _keepAlive = false;
+        else if(strcasecmp(value.c_str(), "keep-alive") == 0)
+            _keepAlive = true;
+    }
+    else if(strcasecmp(name.c_str(), "Content-Encoding") == 0) {
+        if(strcasecmp(value.c_str(), "gzip") == 0 || strcasecmp(value.c_str(), "x-gzip") == 0 || strcasecmp(value.c_str(), "deflate") == 0) {
+            // Compressed twice, not supported.
+            if(_inflate)
+                return false;
+
+            _inflate = new z_stream;
+            memset(_inflate, 0, sizeof(z_stream));
+
+            // Detect the gzip or zlib header automatically.
+            if(inflateInit2(_inflate, 15 + 32) != Z_OK) {
+                delete _inflate;
+                _inflate = 0;
+                return false;
+            }
+        }
+        else if(strcasecmp(value.c_str(), "identity") != 0)
+            return false;
+    }
+
+    return true;
+}
+
+// Headers are over, decide how the body is delimited.
+bool ResponseReader::startBody() {
+
+    // Interim responses are followed by the final one.
+    if(_statusCode >= 100 && _statusCode < 200) {
+        _state = STATUS_LINE;
+        _chunked = _hasLength = false;
+        _remaining = 0;
+        return true;
+    }
+
+    // No body for these whatever the headers say.
+    if(_head || _statusCode == 204 || _statusCode == 304) {
+        _state = DONE;
+        return true;
+    }
+
+    if(_chunked) {
+        _state = CHUNK_SIZE;
+        return true;
+    }
+
+    if(_hasLength) {
+        _state = (_remaining == 0) ? DONE : BODY;
+        return true;
+    }
+
+    // The body goes until the server closes the connection.
+    _keepAlive = false;
+    _remaining = std::string::npos;
+    _state = BODY;
+    return true;
+}
+
+// Append a piece of body to the output, inflating it if needed.
+bool ResponseReader::appendBody(const char* data, size_t size) {
+
+    if(_inflate == 0) {
+        _output.append(data, size);
+        return true;
+    }
+
+    // Ignore what follows the end of the compressed stream.
+    if(_inflateEnd)
+        return true;
+
+    _inflate->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    _inflate->avail_in = size;
+
+    char buffer[INFLATE_BUFFER_SIZE];
+    do {
+        _inflate->next_out = reinterpret_cast<Bytef*>(buffer);
+        _inflate->avail_out = sizeof(buffer);
+
+        int status = inflate(_inflate, Z_NO_FLUSH);
+        if(status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+            return false;
+
+        _output.append(buffer, sizeof(buffer) - _inflate->avail_out);
+
+        if(status == Z_STREAM_END) {
+            _inflateEnd = true;
+            break;
+        }
+
+        // No progress possible until more input arrives.
+        if(status == Z_BUF_ERROR)
+            break;
+
+    } while(_inflate->avail_in > 0 || _inflate->avail_out == 0);
+
+    return true;
+}
+
+// Consume the bytes read.
+Result ResponseReader::feed(const char* data, size_t size) {
+
+    _received += size;
+    const char* end = data + size;
+
+    while(data < end && _state != DONE) {
+        switch(_state) {
+
+            case STATUS_LINE:
+                if(!readLine(data, end))
+                    break;
+
+                // Tolerate empty lines before the status line.
+                if(!_line.empty() && !parseStatus())
+                    return ERROR;
+
+                if(!_line.empty())
+                    _state = HEADERS;
+                _line.clear();
+                break;
+
+            case HEADERS:
+                if(!readLine(data, end))
+                    break;
+
+                if(_line.empty()) {
+                    if(!startBody())
+                        return ERROR;
+                }
+                else if(!parseHeader())
+                    return ERROR;
+
+                _line.clear();
+                break;
+
+            case BODY: {
+                size_t length = std::min<size_t>(end - data, _remaining);
+                if(!appendBody(data, length))
+                    return ERROR;
+
+                data += length;
+                if(_remaining != std::string::npos) {
+                    _remaining -= length;
+                    if(_remaining == 0)
+                        _state = DONE;
+                }
+                break;
+            }
+
+            case CHUNK_SIZE: {
+                if(!readLine(data, end))
+                    break;
+
+                char* endSize;
+                _remaining = strtoull(_line.c_str(), &endSize, 16);
+                if(endSize == _line.c_str())
+                    return ERROR;
+
+                _line.clear();
+                _state = (_remaining == 0) ? TRAILERS : CHUNK_DATA;
+                break;
+            }
+
+            case CHUNK_DATA: {
+                size_t length = std::min<size_t>(end - data, _remaining);
+                if(!appendBody(data, length))
+                    return ERROR;
+
+                data += length;
+                _remaining -= length;
+                if(_remaining == 0)
+                    _state = CHUNK_END;
+                break;
+            }
+
+            case CHUNK_END:
+                if(!readLine(data, end))
+                    break;
+
+                if(!_line.empty())
+                    return ERROR;
+
+                _state = CHUNK_SIZE;
+                break;
+
+            case TRAILERS:
+                if(!readLine(data, end))
+                    break;
+
+                if(_line.empty())
+                    _state = DONE;
+
+                _line.clear();
+                break;
+
+            case DONE:
+                break;
+        }
+
+        if(_line.size() > MAX_LINE_SIZE)
+            return ERROR;
+    }
+
+    // A truncated compressed body is an error.
+    if(_state == DONE && _inflate && !_inflateEnd && _inflate->total_in > 0)
+        return ERROR;
+
+    return (_state == DONE) ? OK : MORE_DATA;
+}
+
+// The server closed the connection.
+Result ResponseReader::finish() {
+    _keepAlive = false;
+
+    if(_state == BODY && _remaining == std::string::npos) {
+        _state = DONE;
+        return (_inflate && !_inflateEnd) ? ERROR : OK;
+    }
+
+    return (_state == DONE) ? OK : ERROR;
+}
@@ -0,0 +1,100 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+#include <string>
+
+#include "http.h"
+
+typedef struct z_stream_s z_stream;
+
+/// Incremental parser of an HTTP/1.1 response, fed with the bytes as they are read on the socket.
+/// The body is unchunked and inflated on the fly when the server compressed it, so only the
+/// decompressed body is kept in memory.
+class ResponseReader {
+    public:
+        ResponseReader(std::string& output, bool head);
+        ~ResponseReader();
+
+        /// Consume the bytes read, OK once the response is complete, MORE_DATA while incomplete.
+        Result feed(const char* data, size_t size);
+
+        /// The server closed the connection, OK if the body was delimited by the close.
+        Result finish();
+
+        /// Status code of the response, 0 until the status line is read.
+        inline unsigned int statusCode() const { return _statusCode; }
+
+        /// Tells if the connection may be kept for the next request.
+        inline bool keepAlive() const { return _keepAlive; }
+
+        /// Bytes received on the wire, headers and compressed body included.
+        inline size_t received() const { return _received; }
+
+        /// Tells how the body was delimited.
+        inline bool chunked() const { return _chunked; }
+        inline bool hasContentLength() const { return _hasLength; }
+
+    private:
+        enum State {
+            STATUS_LINE,
+            HEADERS,
+            BODY,
+            CHUNK_SIZE,
+            CHUNK_DATA,
+            CHUNK_END,
+            TRAILERS,
+            DONE
+        };
+
+        /// Read one line ending with \r\n, returns false if the line is incomplete.
+        bool readLine(const char*& data, const char* end);
+
+        /// Interpret the status line.
+        bool parseStatus();
+
+        /// Interpret one header line.
+        bool parseHeader();
+
+        /// Headers are over, decide how the body is delimited.
+        bool startBody();
+
+        /// Append a piece of body to the output, inflating it if needed.
+        bool appendBody(const char* data, size_t size);
+
+        std::string& _output;
+        std::string _line;
+        State _state;
+        bool _head;
+        unsigned int _statusCode;
+        bool _keepAlive;
+        bool _chunked;
+        bool _hasLength;
+        size_t _remaining;
+        size_t _received;
+
+        /// Inflate stream of a gzip or deflate body, null if not compressed.
+        z_stream* _inflate;
+        bool _inflateEnd;
+};
+
+#endif // RESPONSE_H
@@ -0,0 +1,100 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "retry.h"
+
+#include <cstring>
+#include <random>
+#include <algorithm>
+
+RetryPolicy::RetryPolicy(unsigned int maxAttempts, std::chrono::milliseconds baseDelay, std::chrono::milliseconds maxDelay)
+: _maxAttempts(std::max(maxAttempts, 1u)),
+  _baseDelay(baseDelay),
+  _maxDelay(maxDelay)
+{
+    // Searches and multi gets are sent with POST but never write.
+    _safeEndpoints.insert("_search");
+    _safeEndpoints.insert("_count");
+    _safeEndpoints.insert("_mget");
+    _safeEndpoints.insert("_msearch");
+    _safeEndpoints.insert("_refresh");
+}
+
+RetryPolicy::~RetryPolicy() {
+}
+
+// Mark an endpoint safe to retry whatever the method.
+void RetryPolicy::addSafeEndpoint(const std::string& endpoint) {
+    _safeEndpoints.insert(endpoint);
+}
+
+// Tells if the request may be sent again after a failure.
+bool RetryPolicy::retryable(const char* method, const char* endUrl) const {
+
+    // Reading twice has the same effect as once. PUT and DELETE are not retried: a replayed index answers
+    // created false and a replayed delete found false, the caller would see a failure for a write that applied.
+    if(strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0)
+        return true;
+
+    if(endUrl == 0)
+        return false;
+
+    // The endpoint is the last element of the path, before the parameters: _search/scroll is not _search.
+    const char* end = strchr(endUrl, '?');
+    if(end == 0)
+        end = endUrl + strlen(endUrl);
+
+    while(end > endUrl && end[-1] == '/')
+        --end;
+
+    const char* begin = end;
+    while(begin > endUrl && begin[-1] != '/')
+        --begin;
+
+    return begin < end && _safeEndpoints.count(std::string(begin, end)) > 0;
+}
+
+// Tells if the failure is worth a retry.
+bool RetryPolicy::transient(unsigned int statusCode) const {
+    switch(statusCode) {
+        // No answer: connection refused, reset or timeout.
+        case 0:
+        // Too many requests, the node rejected it before any work.
+        case 429:
+        case 502:
+        case 503:
+        case 504:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// Delay before the given retry, random between zero and the exponential backoff.
+std::chrono::milliseconds RetryPolicy::backoff(unsigned int retry) const {
+    static thread_local std::mt19937 generator(std::random_device{}());
+
+    long long ceiling = _baseDelay.count() << std::min(retry - 1, 20u);
+    ceiling = std::min<long long>(ceiling, _maxDelay.count());
+
+    std::uniform_int_distribution<long long> distribution(0, std::max<long long>(ceiling, 0));
+    return std::chrono::milliseconds(distribution(generator));
+}
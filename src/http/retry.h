@@ -0,0 +1,60 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef RETRY_H
+#define RETRY_H
+
+#include <string>
+#include <set>
+#include <chrono>
+
+/// Decides if a failed request is sent again and after which delay.
+/// Only requests that cannot apply twice are retried: GET and HEAD, or endpoints marked safe
+/// as _search that are read only whatever the method. Derive to plug another policy.
+class RetryPolicy {
+    public:
+        RetryPolicy(unsigned int maxAttempts = 3, std::chrono::milliseconds baseDelay = std::chrono::milliseconds(50), std::chrono::milliseconds maxDelay = std::chrono::milliseconds(2000));
+        virtual ~RetryPolicy();
+
+        /// Tells if the request may be sent again after a failure.
+        virtual bool retryable(const char* method, const char* endUrl) const;
+
+        /// Tells if the failure is worth a retry: no answer (0), 429, 502, 503 or 504.
+        virtual bool transient(unsigned int statusCode) const;
+
+        /// Delay before the given retry, 1 for the first one. Exponential with full jitter.
+        virtual std::chrono::milliseconds backoff(unsigned int retry) const;
+
+        /// Attempts of a request, the first one included. 1 disables the retries.
+        inline unsigned int maxAttempts() const { return _maxAttempts; }
+
+        /// Mark an endpoint (last path element as _search) safe to retry whatever the method.
+        void addSafeEndpoint(const std::string& endpoint);
+
+    private:
+        unsigned int _maxAttempts;
+        std::chrono::milliseconds _baseDelay;
+        std::chrono::milliseconds _maxDelay;
+
+        /// Read only endpoints.
+        std::set<std::string> _safeEndpoints;
+};
+
+#endif // RETRY_H
@@ -0,0 +1,142 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include "scheduler.h"
+
+Scheduler::Scheduler(std::chrono::milliseconds idleTimeout)
+: _next(0), _idle(0), _running(true), _idleTimeout(idleTimeout) {
+    _timer = std::thread(&Scheduler::timer, this);
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _timerWakeup.notify_all();
+    _workerWakeup.notify_all();
+
+    // The timer is over, no worker is added or reaped anymore.
+    _timer.join();
+    for(std::map<std::thread::id, std::thread>::iterator it = _workers.begin(); it != _workers.end(); ++it)
+        it->second.join();
+}
+
+// Run the function at the given time on a worker, unless cancelled before.
+Scheduler::Task Scheduler::schedule(Clock::time_point when, const std::function<void()>& function) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Task task = ++_next;
+    _functions[task] = function;
+
+    // Only an earlier first task changes the wait of the timer.
+    std::multimap<Clock::time_point, Task>::iterator it = _delayed.insert(std::make_pair(when, task));
+    if(it == _delayed.begin())
+        _timerWakeup.notify_one();
+
+    return task;
+}
+
+// Cancel the task if it did not start.
+bool Scheduler::cancel(Task task) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // The timer and the workers skip the tasks without function.
+    return _functions.erase(task) > 0;
+}
+
+// Fire the tasks at their time.
+void Scheduler::timer() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(_running) {
+        reap();
+
+        if(_delayed.empty()) {
+            _timerWakeup.wait(lock);
+            continue;
+        }
+
+        if(_delayed.begin()->first > Clock::now()) {
+            _timerWakeup.wait_until(lock, _delayed.begin()->first);
+            continue;
+        }
+
+        Task task = _delayed.begin()->second;
+        _delayed.erase(_delayed.begin());
+        if(!_functions.count(task))
+            continue;
+
+        _ready.push_back(task);
+        if(_ready.size() > _idle) {
+            std::thread worker(&Scheduler::work, this);
+            std::thread::id id = worker.get_id();
+            _workers[id].swap(worker);
+        }
+        else
+            _workerWakeup.notify_one();
+    }
+}
+
+// Run the fired tasks.
+void Scheduler::work() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true) {
+        ++_idle;
+        bool woken = _workerWakeup.wait_for(lock, _idleTimeout, [this]{ return !_running || !_ready.empty(); });
+        --_idle;
+
+        if(!_running)
+            return;
+
+        // Idle too long, the timer joins it.
+        if(!woken) {
+            _exited.push_back(std::this_thread::get_id());
+            _timerWakeup.notify_one();
+            return;
+        }
+
+        Task task = _ready.front();
+        _ready.pop_front();
+
+        std::map<Task, std::function<void()> >::iterator it = _functions.find(task);
+        if(it == _functions.end())
+            continue;
+
+        std::function<void()> function;
+        function.swap(it->second);
+        _functions.erase(it);
+
+        lock.unlock();
+        function();
+        lock.lock();
+    }
+}
+
+// Join the workers that exited.
+void Scheduler::reap() {
+    for(std::thread::id id : _exited) {
+        std::map<std::thread::id, std::thread>::iterator it = _workers.find(id);
+        it->second.join();
+        _workers.erase(it);
+    }
+
+    _exited.clear();
+}
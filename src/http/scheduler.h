@@ -0,0 +1,91 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+/// Runs tasks after a delay on long-lived threads, so a task that is mostly cancelled costs no thread.
+/// One timer thread fires the tasks at their time and hands them to idle workers, a worker is started
+/// only when all are busy. A worker idle for the idle timeout exits, so a burst leaves no thread behind.
+class Scheduler {
+    public:
+        typedef std::chrono::steady_clock Clock;
+        typedef uint64_t Task;
+
+        explicit Scheduler(std::chrono::milliseconds idleTimeout = std::chrono::milliseconds(10000));
+        ~Scheduler();
+
+        /// Run the function at the given time on a worker, unless cancelled before. The function must not throw.
+        Task schedule(Clock::time_point when, const std::function<void()>& function);
+
+        /// Cancel the task if it did not start. Tells if it will never run, false if it started or is over.
+        bool cancel(Task task);
+
+    private:
+        Scheduler(const Scheduler&);
+        Scheduler& operator=(const Scheduler&);
+
+        /// Fire the tasks at their time.
+        void timer();
+
+        /// Run the fired tasks, until idle for the idle timeout.
+        void work();
+
+        /// Join the workers that exited. Requires the lock.
+        void reap();
+
+        /// Functions of the tasks not started yet, by task.
+        std::map<Task, std::function<void()> > _functions;
+
+        /// Tasks waiting for their time, by time.
+        std::multimap<Clock::time_point, Task> _delayed;
+
+        /// Tasks fired and waiting for a worker.
+        std::deque<Task> _ready;
+
+        Task _next;
+        size_t _idle;
+        bool _running;
+
+        /// Time before an idle worker exits.
+        std::chrono::milliseconds _idleTimeout;
+
+        std::mutex _mutex;
+        std::condition_variable _timerWakeup;
+        std::condition_variable _workerWakeup;
+        std::thread _timer;
+        std::map<std::thread::id, std::thread> _workers;
+
+        /// Workers that exited, joined by the timer.
+        std::vector<std::thread::id> _exited;
+};
+
+#endif // SCHEDULER_H
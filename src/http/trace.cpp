@@ -0,0 +1,66 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "trace.h"
+
+TraceRequest::TraceRequest()
+: method(0),
+  endUrl(0),
+  userData(0),
+  reused(false),
+  bytesSent(0),
+  bytesReceived(0),
+  statusCode(0),
+  succeeded(false),
+  connect(Clock::duration::zero()),
+  sent(Clock::duration::zero()),
+  firstByte(Clock::duration::zero()),
+  total(Clock::duration::zero())
+{
+}
+
+// Start following a new request, the buffers are kept for the next ones.
+void TraceRequest::reset(const char* requestMethod, const char* requestEndUrl, const std::string& url) {
+    method = requestMethod;
+    endUrl = requestEndUrl;
+    node = url;
+    headers.clear();
+    userData = 0;
+    reused = false;
+    bytesSent = 0;
+    bytesReceived = 0;
+    statusCode = 0;
+    succeeded = false;
+    start = Clock::now();
+    connect = Clock::duration::zero();
+    sent = Clock::duration::zero();
+    firstByte = Clock::duration::zero();
+    total = Clock::duration::zero();
+}
+
+// Add a header to the request.
+void TraceRequest::addHeader(const std::string& name, const std::string& value) {
+    headers.push_back(std::make_pair(name, value));
+}
+
+// Value of the W3C traceparent header.
+std::string traceParent(const std::string& traceId, const std::string& parentId, bool sampled) {
+    return "00-" + traceId + "-" + parentId + (sampled ? "-01" : "-00");
+}
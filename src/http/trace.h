@@ -0,0 +1,109 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+
+/// One request followed by a TraceHook, filled as the request goes. Each attempt of a retried request is traced on its own.
+struct TraceRequest {
+    typedef std::chrono::steady_clock Clock;
+
+    TraceRequest();
+
+    /// Start following a new request.
+    void reset(const char* method, const char* endUrl, const std::string& node);
+
+    /// Add a header to the request, called from onRequestStart.
+    void addHeader(const std::string& name, const std::string& value);
+
+    /// Method and end of the url of the request, node as given to the client.
+    const char* method;
+    const char* endUrl;
+    std::string node;
+
+    /// Extra headers sent with the request.
+    std::vector< std::pair<std::string, std::string> > headers;
+
+    /// Free for the hook, as the span of the request.
+    void* userData;
+
+    /// The request was sent on a connection kept from a previous one.
+    bool reused;
+
+    /// Bytes written, headers and compressed body included, and bytes read.
+    size_t bytesSent;
+    size_t bytesReceived;
+
+    /// Status code of the response, 0 if none, and whether the response was read with a success status.
+    unsigned int statusCode;
+    bool succeeded;
+
+    /// Start of the request, then the time taken to connect (zero if reused), to write the request,
+    /// to read the first byte of the response and to complete, all since the start.
+    Clock::time_point start;
+    Clock::duration connect;
+    Clock::duration sent;
+    Clock::duration firstByte;
+    Clock::duration total;
+};
+
+/// Callbacks along every request of the client, to feed a distributed tracing system. The hook is shared by the connections,
+/// it is called from the threads of the requests, while the connection is held, and must not throw.
+/// The parsing of the response is not included.
+///
+/// class Tracer : public TraceHook {
+///     void onRequestStart(TraceRequest& request) {
+///         Span* span = startSpan(request.method, request.endUrl);
+///         request.userData = span;
+///         request.addHeader("traceparent", traceParent(span->traceId(), span->id(), true));
+///     }
+///     void onComplete(const TraceRequest& request) {
+///         static_cast<Span*>(request.userData)->end(request.statusCode, request.total);
+///     }
+/// };
+class TraceHook {
+    public:
+        virtual ~TraceHook() {}
+
+        /// Before the connection, extra headers may be added to the request.
+        virtual void onRequestStart(TraceRequest&) {}
+
+        /// The whole request is written on the socket.
+        virtual void onBytesSent(const TraceRequest&) {}
+
+        /// The first bytes of the response are read.
+        virtual void onFirstByte(const TraceRequest&) {}
+
+        /// The request is over, also called if it failed or threw.
+        virtual void onComplete(const TraceRequest&) {}
+};
+
+/// Value of the W3C traceparent header: version 00, the trace id in 32 hexadecimal digits,
+/// the id of the parent span in 16 and the sampled flag.
+std::string traceParent(const std::string& traceId, const std::string& parentId, bool sampled);
+
+#endif // TRACE_H
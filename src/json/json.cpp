@@ -28,8 +28,48 @@
 
 #define BACKSLASH 0x5c
 
+/// Deepest nesting of objects and arrays, deeper messages would overflow the stack.
+#define JSON_MAX_DEPTH 512
+
 using namespace std;
 
+namespace {
+
+/// Nesting of the object or array being parsed by the thread.
+thread_local unsigned int depth = 0;
+
+/// Count one more level of nesting while an object or array is parsed.
+struct DepthGuard {
+    DepthGuard() {
+        if(++depth > JSON_MAX_DEPTH) {
+            --depth;
+            throw std::logic_error("JSON illformed, nested too deep.");
+        }
+    }
+    ~DepthGuard() { --depth; }
+};
+
+/// Find the quote closing the string starting after pCursor, the escaped characters are skipped.
+const char* endOfString(const char* pCursor, const char* pEnd) {
+    while(pCursor < pEnd && *pCursor != '"') {
+        if(*pCursor == BACKSLASH && pCursor + 1 < pEnd)
+            ++pCursor;
+        ++pCursor;
+    }
+
+    if(pCursor >= pEnd)
+        throw std::logic_error("String illformed, end of the string reached.");
+
+    return pCursor;
+}
+
+/// Tells if the character may follow a value.
+inline bool endOfValue(char c) {
+    return isspace(c) || c == ',' || c == '}' || c == ']';
+}
+
+}
+
 /*------------------- Json Value ------------------*/
 
 
@@ -401,6 +441,9 @@ const char* Json::Value::read(const char* pCursor, const char* pEnd){
     while(pCursor < pEnd && isspace(*pCursor))
         ++pCursor;
 
+    if(pCursor >= pEnd)
+        throw std::logic_error("Value illformed, end of the string reached.");
+
     const char* startPoint = pCursor;
     const char* endPoint = pCursor;
 
@@ -462,21 +505,13 @@ const char* Json::Value::read(const char* pCursor, const char* pEnd){
             ++pCursor;
 
             // Move until the end of the string.
-            while(pCursor < pEnd)
-                if(*pCursor == '"' && *(pCursor - 1) != BACKSLASH)
-                    break;
-                else
-                    ++pCursor;
+            pCursor = endOfString(pCursor, pEnd);
 
             endPoint = pCursor;
             ++pCursor;
 
-            #ifndef NDEBUG
-            if(!(isspace(*pCursor) || *pCursor == ',' || *pCursor == '}' || *pCursor == ']'))
-                printf("Debug Read 2: %s\n", pCursor);
-            #endif
-
-            assert( isspace(*pCursor) || *pCursor == ',' || *pCursor == '}' || *pCursor == ']');
+            if(pCursor < pEnd && !endOfValue(*pCursor))
+                throw std::logic_error("String illformed, unexpected character after the string.");
             break;
 
         case '{':
@@ -632,66 +667,61 @@ Json::Object::Object(const Object& obj): _memberMap(obj._memberMap){
 
 }
 
-/// Loops over the string and splits into members.
+/// Loops over the string and splits into members, endStr is past the last character.
 const char* Json::Object::addMember(const char* startStr, const char* endStr){
 
     // Means it starts with {
-    if(startStr[0] != '{')
+    if(startStr >= endStr || startStr[0] != '{')
         throw std::logic_error("Object illformed, does not start with {");
 
+    DepthGuard guard;
     ++startStr;
 
     // Loop over members.
-    while(startStr <= endStr) {
-
-        // Key start and end point.
-        const char* pKeyStart = 0;
-        const char* pKeyEnd = 0;
+    for(bool first = true; ; first = false) {
 
         // Remove white spaces until we find the key.
-        while(startStr <= endStr && isspace(*startStr))
+        while(startStr < endStr && isspace(*startStr))
             ++startStr;
 
+        // We must never reach the end of the string.
+        if(startStr >= endStr)
+            throw std::logic_error("Object illformed, end of the string reached.");
+
         // The object is empty.
-        if(*startStr == '}')
+        if(*startStr == '}' && first)
             break;
 
-        pKeyStart = ++startStr;
-
-        // Loop until the end of the key.
-        while(startStr <= endStr){
+        if(*startStr != '"')
+            throw std::logic_error("Object illformed, key does not start with a quote.");
 
-            if(*startStr == '"'  && *(startStr - 1) != BACKSLASH){
-                pKeyEnd = startStr - 1;
-                ++startStr;
-                break;
-            }
+        // Key start and end point.
+        const char* pKeyStart = ++startStr;
+        const char* pKeyEnd = endOfString(startStr, endStr);
+        startStr = pKeyEnd + 1;
 
+        // Move to the beginning of the value.
+        while(startStr < endStr && isspace(*startStr))
             ++startStr;
-        }
-
-        // Loop to move to the beginning of the value.
-        while(startStr <= endStr){
 
-            if(*startStr == ':'){
-                ++startStr;
-                break;
-            }
+        if(startStr >= endStr || *startStr != ':')
+            throw std::logic_error("Object illformed, missing colon after the key.");
 
-            ++startStr;
-        }
+        ++startStr;
 
-        // We must never reach the end of the string.
-        if(*startStr == '\0')
-            throw std::logic_error("Object illformed, end of the string reached.");
+        // The last value of a duplicated key wins.
+        Key key(pKeyStart, pKeyEnd - pKeyStart);
+        _memberMap.erase(key);
 
         // Get the end of the value.
-        startStr = _memberMap[ Key(pKeyStart, pKeyEnd - pKeyStart + 1) ].read(startStr, endStr);
+        startStr = _memberMap[key].read(startStr, endStr);
 
         // Remove white spaces at the end of the value if any.
-        while(isspace(*startStr)){
+        while(startStr < endStr && isspace(*startStr))
             ++startStr;
-        }
+
+        if(startStr >= endStr)
+            throw std::logic_error("Object illformed, end of the string reached.");
 
         // We reached the end of the child member.
         if(*startStr == '}')
@@ -704,9 +734,6 @@ const char* Json::Object::addMember(const char* startStr, const char* endStr){
         ++startStr;
     }
 
-    if(*startStr != '}')
-        throw std::logic_error("Object illformed, does not end with }");
-
     ++startStr;
 
     assert(startStr <= endStr);
@@ -868,39 +895,50 @@ Json::Array::Array(){
 
 }
 
-// Loops over the string, splits into elements and returns the consummed size
+// Loops over the string, splits into elements and returns the consummed size, pEnd is past the last character.
 const char* Json::Array::addElement(const char* pStart, const char* pEnd){
 
     // Means it starts with [
-    assert(pStart[0] == '[');
+    if(pStart >= pEnd || pStart[0] != '[')
+        throw std::logic_error("Array illformed, does not start with [");
+
+    DepthGuard guard;
     ++pStart;
 
     // Remove white spaces until we find the first value.
-    while(pStart <= pEnd && isspace(*pStart))
+    while(pStart < pEnd && isspace(*pStart))
         ++pStart;
 
+    if(pStart >= pEnd)
+        throw std::logic_error("Array illformed, end of the string reached.");
+
     // The array is empty.
     if(*pStart == ']')
         return ++pStart;
 
-    while(pStart <= pEnd){
+    while(true){
         _elementList.push_back(Value());
         pStart = _elementList.back().read(pStart, pEnd);
 
         // Remove white spaces until we find the end of the array or the next value.
-        while(pStart <= pEnd && isspace(*pStart))
+        while(pStart < pEnd && isspace(*pStart))
             ++pStart;
 
+        if(pStart >= pEnd)
+            throw std::logic_error("Array illformed, end of the string reached.");
+
         if(*pStart == ']')
             break;
 
-        assert(*pStart == ',' || pStart > pEnd);
+        if(*pStart != ',')
+            throw std::logic_error("Array illformed, missing coma element separator.");
+
         ++pStart;
     }
 
     ++pStart;
 
-   assert(pStart <= pEnd);
+    assert(pStart <= pEnd);
 
     // Returns the consummed size
     return pStart;
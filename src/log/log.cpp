@@ -0,0 +1,225 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include "log.h"
+
+#include <ctime>
+#include <cstring>
+
+/// Messages kept in the queue before new ones are dropped.
+#define LOG_QUEUE_CAPACITY 8192
+
+LogSite::LogSite(const char* file, int line)
+: file(file),
+  line(line),
+  _second(-1),
+  _count(0),
+  _suppressed(0)
+{
+}
+
+// Tells if one more message fits in the current second, counting the ones that do not.
+bool LogSite::admit(unsigned int perSecond, unsigned int& suppressed) {
+    suppressed = 0;
+    if(perSecond == 0)
+        return true;
+
+    long long now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    long long second = _second.load(std::memory_order_relaxed);
+
+    // First message of a new second, report the ones suppressed before.
+    if(second != now && _second.compare_exchange_strong(second, now, std::memory_order_relaxed)) {
+        _count.store(0, std::memory_order_relaxed);
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+    }
+
+    if(_count.fetch_add(1, std::memory_order_relaxed) < perSecond)
+        return true;
+
+    _suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+LogSink::~LogSink() {
+}
+
+void LogSink::flush() {
+}
+
+StreamSink::StreamSink(FILE* stream): _stream(stream) {
+}
+
+// Write the message as one line with its UTC time, level and place.
+void StreamSink::write(const LogRecord& record) {
+    long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(record.time.time_since_epoch()).count();
+    time_t seconds = milliseconds / 1000;
+
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+
+    char time[32];
+    size_t length = strftime(time, sizeof(time), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(time + length, sizeof(time) - length, ".%03dZ", static_cast<int>(milliseconds % 1000));
+
+    const char* file = strrchr(record.file, '/');
+    file = file ? file + 1 : record.file;
+
+    fprintf(_stream, "%s %s %s:%d %s\n", time, Logger::name(record.level), file, record.line, record.message.c_str());
+}
+
+void StreamSink::flush() {
+    fflush(_stream);
+}
+
+std::atomic<int> Logger::_level(static_cast<int>(LogLevel::WARNING));
+
+Logger::Logger()
+: _rateLimit(20),
+  _sink(std::make_shared<StreamSink>()),
+  _capacity(LOG_QUEUE_CAPACITY),
+  _dropped(0),
+  _writing(false),
+  _stop(false)
+{
+}
+
+// Write what is left in the queue.
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wakeUp.notify_one();
+
+    if(_thread.joinable())
+        _thread.join();
+}
+
+// Process wide logger.
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+void Logger::setLevel(LogLevel level) {
+    _level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel Logger::level() {
+    return static_cast<LogLevel>(_level.load(std::memory_order_relaxed));
+}
+
+// Destination of the messages.
+void Logger::setSink(const std::shared_ptr<LogSink>& sink) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sink = sink;
+}
+
+// Messages per second of each log call.
+void Logger::setRateLimit(unsigned int perSecond) {
+    _rateLimit.store(perSecond, std::memory_order_relaxed);
+}
+
+// Queue a message, the thread writing them is started with the first one.
+void Logger::log(LogSite& site, LogLevel level, std::string message) {
+    unsigned int suppressed;
+    if(!site.admit(_rateLimit.load(std::memory_order_relaxed), suppressed))
+        return;
+
+    if(suppressed > 0)
+        message += " (" + std::to_string(suppressed) + " similar messages suppressed)";
+
+    LogRecord record;
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+    record.file = site.file;
+    record.line = site.line;
+    record.message.swap(message);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_queue.size() >= _capacity) {
+            ++_dropped;
+            return;
+        }
+
+        _queue.push_back(std::move(record));
+
+        if(!_thread.joinable())
+            _thread = std::thread(&Logger::run, this);
+    }
+    _wakeUp.notify_one();
+}
+
+// Wait until the queued messages are written.
+void Logger::flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]{ return (_queue.empty() && !_writing) || !_thread.joinable(); });
+}
+
+// Write the queued messages in background, without holding the lock while the sink writes.
+void Logger::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while(true) {
+        _wakeUp.wait(lock, [this]{ return !_queue.empty() || _stop; });
+
+        if(_queue.empty() && _stop)
+            return;
+
+        std::deque<LogRecord> records;
+        records.swap(_queue);
+        std::shared_ptr<LogSink> sink = _sink;
+
+        size_t dropped = _dropped;
+        _dropped = 0;
+        _writing = true;
+
+        lock.unlock();
+
+        if(sink) {
+            for(const LogRecord& record : records)
+                sink->write(record);
+
+            if(dropped > 0) {
+                LogRecord record;
+                record.level = LogLevel::WARNING;
+                record.time = std::chrono::system_clock::now();
+                record.file = __FILE__;
+                record.line = __LINE__;
+                record.message = std::to_string(dropped) + " messages dropped, the log queue was full.";
+                sink->write(record);
+            }
+
+            sink->flush();
+        }
+
+        lock.lock();
+        _writing = false;
+        _idle.notify_all();
+    }
+}
+
+// Name of the level as written in the messages.
+const char* Logger::name(LogLevel level) {
+    static const char* names[] = { "TRACE", "DEBUG", "INFO", "WARNING", "ERROR", "OFF" };
+    return names[static_cast<int>(level)];
+}
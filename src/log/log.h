@@ -0,0 +1,151 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <sstream>
+#include <cstdio>
+
+/// Log a message built with the stream operator at the level TRACE, DEBUG, INFO, WARNING or ERROR:
+/// ES_LOG(WARNING, "Weird status code: " << statusCode);
+/// A disabled level costs one branch, the message is not built.
+#define ES_LOG(level, message) \
+    do { \
+        if(Logger::enabled(LogLevel::level)) { \
+            static LogSite _logSite(__FILE__, __LINE__); \
+            std::ostringstream _logStream; \
+            _logStream << message; \
+            Logger::instance().log(_logSite, LogLevel::level, _logStream.str()); \
+        } \
+    } while(0)
+
+enum class LogLevel { TRACE, DEBUG, INFO, WARNING, ERROR, OFF };
+
+/// One message to write.
+struct LogRecord {
+    LogLevel level;
+    std::chrono::system_clock::time_point time;
+    const char* file;
+    int line;
+    std::string message;
+};
+
+/// Place of a log call, its messages are rate limited together.
+class LogSite {
+    public:
+        LogSite(const char* file, int line);
+
+        /// Tells if one more message fits in the current second, and how many were suppressed in the previous ones.
+        bool admit(unsigned int perSecond, unsigned int& suppressed);
+
+        const char* const file;
+        const int line;
+
+    private:
+        std::atomic<long long> _second;
+        std::atomic<unsigned int> _count;
+        std::atomic<unsigned int> _suppressed;
+};
+
+/// Destination of the messages, called from the logging thread only.
+class LogSink {
+    public:
+        virtual ~LogSink();
+
+        virtual void write(const LogRecord& record) = 0;
+
+        /// Push the buffered messages, when the logger is flushed.
+        virtual void flush();
+};
+
+/// Write the messages as lines to a C stream, stderr by default:
+/// 2015-06-01T10:00:00.123Z WARNING http.cpp:512 Weird status code: 302
+class StreamSink : public LogSink {
+    public:
+        explicit StreamSink(FILE* stream = stderr);
+
+        virtual void write(const LogRecord& record);
+        virtual void flush();
+
+    private:
+        FILE* _stream;
+};
+
+/// Process wide asynchronous logger. The messages are queued and written by a background thread,
+/// so a log call never waits for the sink; when the queue is full the messages are dropped and counted.
+class Logger {
+    public:
+        static Logger& instance();
+
+        /// Tells if the messages of the level are logged, WARNING and above by default.
+        static inline bool enabled(LogLevel level) { return static_cast<int>(level) >= _level.load(std::memory_order_relaxed); }
+
+        static void setLevel(LogLevel level);
+        static LogLevel level();
+
+        /// Destination of the messages, a StreamSink on stderr by default, null discards them.
+        void setSink(const std::shared_ptr<LogSink>& sink);
+
+        /// Messages per second of each log call above which they are suppressed, 0 for no limit. 20 by default.
+        void setRateLimit(unsigned int perSecond);
+
+        /// Queue a message, use ES_LOG.
+        void log(LogSite& site, LogLevel level, std::string message);
+
+        /// Wait until the queued messages are written.
+        void flush();
+
+        static const char* name(LogLevel level);
+
+    private:
+        Logger();
+        ~Logger();
+
+        /// Write the queued messages in background.
+        void run();
+
+        static std::atomic<int> _level;
+
+        std::atomic<unsigned int> _rateLimit;
+
+        std::shared_ptr<LogSink> _sink;
+        std::deque<LogRecord> _queue;
+        size_t _capacity;
+        size_t _dropped;
+        bool _writing;
+        bool _stop;
+
+        std::mutex _mutex;
+        std::condition_variable _wakeUp;
+        std::condition_variable _idle;
+        std::thread _thread;
+};
+
+#endif // LOG_H
@@ -0,0 +1,128 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <gtest/gtest.h>
+
+#include "elasticsearch/cache.h"
+
+typedef DocumentCache::Clock Clock;
+
+// Get response of a found document.
+static Json::Object document(long version, const std::string& value) {
+    Json::Object source;
+    source.addMemberByKey("value", value);
+
+    Json::Object msg;
+    msg.addMemberByKey("_version", version);
+    msg.addMemberByKey("found", true);
+    msg.addMemberByKey("_source", source);
+    return msg;
+}
+
+// Value of the cached document, empty if not cached.
+static std::string cached(DocumentCache& cache, const std::string& id) {
+    Json::Object msg;
+    if(!cache.get("index", "type", id, msg))
+        return std::string();
+
+    return msg["_source"].getObject()["value"].getString();
+}
+
+TEST(DocumentCache, StoresFoundDocuments) {
+    DocumentCache cache(16, std::chrono::seconds(60), 1);
+
+    cache.put("index", "type", "1", document(1, "one"), Clock::now(), cache.generation());
+    EXPECT_EQ("one", cached(cache, "1"));
+    EXPECT_EQ("", cached(cache, "2"));
+}
+
+TEST(DocumentCache, TombstoneDropsOlderGet) {
+    DocumentCache cache(16, std::chrono::seconds(60), 1);
+
+    cache.put("index", "type", "1", document(0, "before"), Clock::now(), cache.generation());
+
+    // A get sent before a write of unknown version, answered after it.
+    Clock::time_point requested = Clock::now() - std::chrono::milliseconds(1);
+    cache.invalidate("index", "type", "1");
+    EXPECT_EQ("", cached(cache, "1"));
+
+    cache.put("index", "type", "1", document(0, "stale"), requested, cache.generation());
+    EXPECT_EQ("", cached(cache, "1"));
+
+    // A get sent after the write is stored.
+    cache.put("index", "type", "1", document(0, "after"), Clock::now(), cache.generation());
+    EXPECT_EQ("after", cached(cache, "1"));
+}
+
+TEST(DocumentCache, TombstoneKeepsWrittenVersion) {
+    DocumentCache cache(16, std::chrono::seconds(60), 1);
+
+    cache.invalidate("index", "type", "1", 3);
+
+    cache.put("index", "type", "1", document(2, "older"), Clock::now(), cache.generation());
+    EXPECT_EQ("", cached(cache, "1"));
+
+    cache.put("index", "type", "1", document(3, "written"), Clock::now() - std::chrono::seconds(1), cache.generation());
+    EXPECT_EQ("written", cached(cache, "1"));
+}
+
+TEST(DocumentCache, TombstonesOutliveEviction) {
+    DocumentCache cache(2, std::chrono::seconds(60), 1);
+
+    Clock::time_point requested = Clock::now() - std::chrono::milliseconds(1);
+    cache.invalidate("index", "type", "1");
+
+    // Fill the shard past its capacity with other documents.
+    for(int i = 2; i < 10; ++i)
+        cache.put("index", "type", std::to_string(i), document(1, "filler"), Clock::now(), cache.generation());
+
+    cache.put("index", "type", "1", document(0, "stale"), requested, cache.generation());
+    EXPECT_EQ("", cached(cache, "1"));
+}
+
+TEST(DocumentCache, VersionedPutNeverReplacesNewer) {
+    DocumentCache cache(16, std::chrono::seconds(60), 1);
+
+    cache.put("index", "type", "1", document(5, "five"), Clock::now(), cache.generation());
+    cache.put("index", "type", "1", document(4, "four"), Clock::now(), cache.generation());
+    EXPECT_EQ("five", cached(cache, "1"));
+
+    cache.put("index", "type", "1", document(6, "six"), Clock::now(), cache.generation());
+    EXPECT_EQ("six", cached(cache, "1"));
+}
+
+TEST(DocumentCache, ClearDropsGetsOfPreviousGeneration) {
+    DocumentCache cache(16, std::chrono::seconds(60), 1);
+
+    cache.put("index", "type", "1", document(1, "one"), Clock::now(), cache.generation());
+
+    uint64_t generation = cache.generation();
+    cache.clear();
+    EXPECT_EQ("", cached(cache, "1"));
+    EXPECT_NE(generation, cache.generation());
+
+    // A get sent before the clear is not stored back.
+    cache.put("index", "type", "2", document(1, "two"), Clock::now(), generation);
+    EXPECT_EQ("", cached(cache, "2"));
+
+    cache.put("index", "type", "2", document(1, "two"), Clock::now(), cache.generation());
+    EXPECT_EQ("two", cached(cache, "2"));
+}
@@ -0,0 +1,96 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "http/retry.h"
+
+TEST(RetryPolicy, ReadsAreRetryable) {
+    RetryPolicy policy;
+
+    EXPECT_TRUE(policy.retryable("GET", "index/type/1"));
+    EXPECT_TRUE(policy.retryable("HEAD", "index"));
+    EXPECT_TRUE(policy.retryable("GET", 0));
+}
+
+TEST(RetryPolicy, WritesAreNotRetryable) {
+    RetryPolicy policy;
+
+    EXPECT_FALSE(policy.retryable("PUT", "index/type/1"));
+    EXPECT_FALSE(policy.retryable("DELETE", "index/type/1"));
+    EXPECT_FALSE(policy.retryable("POST", "index/type/1/_update"));
+    EXPECT_FALSE(policy.retryable("POST", "_bulk"));
+    EXPECT_FALSE(policy.retryable("POST", 0));
+}
+
+TEST(RetryPolicy, SafeEndpointIsLastPathElement) {
+    RetryPolicy policy;
+
+    EXPECT_TRUE(policy.retryable("POST", "index/type/_search"));
+    EXPECT_TRUE(policy.retryable("POST", "index/type/_search?timeout=10ms"));
+    EXPECT_TRUE(policy.retryable("POST", "index/type/_search/"));
+    EXPECT_TRUE(policy.retryable("POST", "_mget"));
+    EXPECT_TRUE(policy.retryable("POST", "index/_count"));
+
+    // Scrolls move a cursor on the server.
+    EXPECT_FALSE(policy.retryable("POST", "_search/scroll"));
+
+    // Only the path counts, not the parameters.
+    EXPECT_FALSE(policy.retryable("POST", "index/type/1?q=_search"));
+    EXPECT_FALSE(policy.retryable("POST", "_search_template_like"));
+    EXPECT_FALSE(policy.retryable("POST", ""));
+}
+
+TEST(RetryPolicy, AddedSafeEndpoint) {
+    RetryPolicy policy;
+
+    EXPECT_FALSE(policy.retryable("POST", "index/_field_caps"));
+    policy.addSafeEndpoint("_field_caps");
+    EXPECT_TRUE(policy.retryable("POST", "index/_field_caps?fields=*"));
+}
+
+TEST(RetryPolicy, TransientStatuses) {
+    RetryPolicy policy;
+
+    EXPECT_TRUE(policy.transient(0));
+    EXPECT_TRUE(policy.transient(429));
+    EXPECT_TRUE(policy.transient(502));
+    EXPECT_TRUE(policy.transient(503));
+    EXPECT_TRUE(policy.transient(504));
+
+    EXPECT_FALSE(policy.transient(200));
+    EXPECT_FALSE(policy.transient(404));
+    EXPECT_FALSE(policy.transient(409));
+    EXPECT_FALSE(policy.transient(500));
+}
+
+TEST(RetryPolicy, BackoffIsBounded) {
+    RetryPolicy policy(5, std::chrono::milliseconds(10), std::chrono::milliseconds(40));
+
+    EXPECT_EQ(5u, policy.maxAttempts());
+    for(unsigned int retry = 1; retry < 30; ++retry) {
+        std::chrono::milliseconds delay = policy.backoff(retry);
+        EXPECT_GE(delay.count(), 0);
+        EXPECT_LE(delay.count(), std::min<long long>(10LL << std::min(retry - 1, 20u), 40));
+    }
+}
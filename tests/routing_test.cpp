@@ -0,0 +1,46 @@
+/*
+ * Licensed to cpp-elasticsearch under one or more contributor
+ * license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright
+ * ownership. Elasticsearch licenses this file to you under
+ * the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "elasticsearch/routing.h"
+
+// Vectors of Murmur3HashFunctionTests of Elasticsearch.
+TEST(ShardRouter, HashMatchesElasticsearch) {
+    EXPECT_EQ(static_cast<int32_t>(0x5a0cb7c3), ShardRouter::hash("hell"));
+    EXPECT_EQ(static_cast<int32_t>(0xd7c31989), ShardRouter::hash("hello"));
+    EXPECT_EQ(static_cast<int32_t>(0x22ab2984), ShardRouter::hash("hello w"));
+    EXPECT_EQ(static_cast<int32_t>(0xdf0ca123), ShardRouter::hash("hello wo"));
+    EXPECT_EQ(static_cast<int32_t>(0xe7744d61), ShardRouter::hash("hello wor"));
+    EXPECT_EQ(static_cast<int32_t>(0xe07db09c), ShardRouter::hash("The quick brown fox jumps over the lazy dog"));
+    EXPECT_EQ(static_cast<int32_t>(0x4e63d2ad), ShardRouter::hash("The quick brown fox jumps over the lazy cog"));
+}
+
+TEST(ShardRouter, ShardIdWithRoutingFactor) {
+    // floorMod(0x5a0cb7c3, 1024) is 963, 256 routing shards by shard.
+    EXPECT_EQ(3, ShardRouter::shardId("hell", 1024, 4));
+
+    // A negative hash, floorMod(0xd7c31989, 1024) is 393.
+    EXPECT_EQ(1, ShardRouter::shardId("hello", 1024, 4));
+    EXPECT_EQ(393, ShardRouter::shardId("hello", 1024, 1024));
+}